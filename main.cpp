@@ -5,18 +5,70 @@
 #include <string.h>
 #include <sys/time.h>
 #include <stdlib.h>
+#include <math.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define CarColor 10
 #define BoardDim 20
 #define RoadHeight 1
-#define RoadNumber 8
-#define ObstacleNumber 9
+#define RoadNumber 8 // domyslna liczba drog gdy nie ma jej w config.txt
+#define ObstacleNumber 9 // domyslna liczba przeszkod
 #define JumpDelay 0.2
+#define JumpDelayTicks ((int)(JumpDelay * 1000000 / FrameDelay + 0.5))
 #define FrameDelay 30000
 #define RefreshDelay 15000
 #define TextHeight 10
 #define FriendlyPushDistance 1
 #define StoppingDistance 3
+#define LaneGap 4 // najmniejszy odstep miedzy poczatkami samochodow w pasie: trzy pola samochodu i jedno wolne
+#define HeadlessTicks 1000000
+#define MonteCarloTicks 6000 // limit jednej gry w Monte Carlo (3 minuty gry)
+#define MonteCarloChunk 16 // ile gier watek bierze na raz
+#define HeatmapWidth 60 // kolumny mapy smierci
+#define ReplaySpeed 4 // ile razy szybciej niz w grze odtwarzany jest zapis na ekranie
+#define AnsiTextLength 256 // najdluzszy napis w put_text
+#define EventLogSize (1 << 16) // zdarzenia w pierscieniu, przy pelnym nowe przepadaja
+#define EventFlushDelay 20000 // co ile mikrosekund watek zapisu oproznia pierscien
+#define SpectatorSlots 4 // klatki w pierscieniu dla widzow, wolny widz bierze najnowsza
+#define SpectatorVersion 1
+#define InputQueueSize 64 // klawisze czekajace na wykonanie, nadmiar przepada
+#define TripleFresh 4 // bit w TripleBuffer.middle: klatka jeszcze nie wzieta przez watek rysujacy
+#define ClockMaxCatchUp 8 // najwiecej tickow nadrabianych w jednym obrocie petli, reszta w nastepnych
+#define ReplayVersion 3 // 3 - bajt flag (tryb endless) po konfiguracji
+#define ParkedRow (1 << 30) // wiersz swiata poza kazdym widokiem: samochody i przeszkody czekajace na nowy wiersz
+#define SolverMaxNodes (1 << 22) // limit stanow przeszukiwania, powyzej plansza uznana za nierozwiazana
+#define LevelMaxNodes (1 << 16) // przy generowaniu poziomow trudniejsze plansze odrzucamy (plus jeden stan na pole planszy)
+#define LevelVersion 1
+#define HistogramSubBuckets 16 // podzial kazdej potegi dwojki, blad pomiaru ponizej 1/16
+#define HistogramBuckets (64 * HistogramSubBuckets)
+#define StatsRow (TextHeight + 5) // nakladka ze statystykami pod display_info
+#define BenchNanoseconds 200000000LL // jak dlugo mierzymy jeden benchmark
+#define BenchPositions 1024 // losowe pozycje zaby w testach kolizji
+#define BenchFrames 1000 // klatki do liczenia bajtow wyslanych do terminala
+#define EnvActions 6
+#define EnvActionRounds 64 // tyle zestawow losowych akcji krazy w --envbench
+#define EnvBenchNanoseconds 2000000000LL
+#define EnvSpins 2000 // tyle razy bezczynny watek VecEnv sprawdza nowe zlecenie zanim zasnie
+#define LookaheadDepth 3 // tyle skokow do przodu patrzy polityka lookahead
+#define LookaheadWin 1000000000
+#define LookaheadTableBits 20
+#define ServerEvents 256
+#define ServerBacklog 16384 // tyle niewyslanych bajtow i klient nie dostaje nowych klatek
+#define ServerReport 10000000 // co ile mikrosekund serwer wypisuje statystyki
 
 using namespace std;
 
@@ -30,8 +82,28 @@ typedef struct
     int number_of_hostile_cars;
 
     int number_of_stopping_cars;
+
+    int number_of_roads;
+
+    int number_of_obstacles;
+
+    int endless; // 1 - plansza bez konca, widok przewija sie za zaba
 } GameConfig;
 
+//Random number generator of one game (xoshiro256**)
+typedef struct
+{
+    uint64_t s[4];
+} Rng;
+
+//One block of memory for the whole game, carved up at startup
+typedef struct
+{
+    char *base;
+    size_t size;
+    size_t used;
+} Arena;
+
 typedef struct
 {
     int x;
@@ -44,14 +116,44 @@ typedef struct
     int y;
 } Finish;
 
+typedef enum
+{
+    CarHostile,
+    CarFriendly,
+    CarStopping,
+    CarKinds
+} CarKind;
+
+//Cars as structure of arrays, grouped by behavior: hostile, friendly, stopping
 typedef struct
 {
-    int x;
-    int y;
-    int direction;
-    int speed;
-    int is_static;
-} Car;
+    int count;
+    int begin[CarKinds + 1]; // samochody rodzaju k maja indeksy od begin[k] do begin[k + 1] - 1
+    int *x;
+    int *y;
+    int *direction;
+    int *speed;
+    int *is_static;
+    int *old_x; // pozycje sprzed ruchu, do aktualizacji zajetosci
+    int *edge; // flagi, a potem lista samochodow ktore dotarly do krawedzi
+    int *roll; // wylosowane liczby dla calej grupy
+    int *new_speed;
+    int *coin;
+} CarStore;
+
+//Roads with more than one car: car indices of every lane sorted by x, a car at a cell is a binary search away
+typedef struct
+{
+    bool dense; // wiecej samochodow niz drog, wtedy caly pas jedzie w jednym kierunku i zawija na krawedziach
+    int count; // liczba pasow (drog)
+    int rows;
+    int *begin; // samochody pasa k to cars[begin[k]] .. cars[begin[k + 1] - 1]
+    int *cars; // indeksy samochodow, w kazdym pasie rosnaco po x
+    int *y;
+    int *direction; // wspolny kierunek pasa
+    int *row_lane; // pas na danym wierszu (-1 - brak)
+    int *step; // pomocnicza: czy samochod z tego miejsca rusza sie w tym ticku
+} Lanes;
 
 typedef struct
 {
@@ -65,930 +167,6551 @@ typedef struct
     int car_index;
 } PushingCar;
 
-//Load configuration from file
-int load_config(const char *file, GameConfig *config)
+//One bit per board cell, a separate layer for every kind of element
+typedef struct
 {
-    FILE *config_game = fopen(file, "r");
-    if (config_game == nullptr)
-    {
-        perror("Cannot open config file");
-        return 1;
-    }
+    int rows;
+    int words; // ile slow 64-bitowych na jeden wiersz
+    int top; // wiersz swiata na gorze widoku (0 gdy plansza stoi)
+    int base; // miejsce wiersza top w pierscieniu wierszy
+    uint64_t *obstacle;
+    uint64_t *hostile;
+    uint64_t *friendly;
+    uint64_t *stopping;
+} Occupancy;
+
+typedef enum
+{
+    SimRunning,
+    SimWon,
+    SimLost
+} SimState;
 
-    fscanf(config_game, "playing_area_width %d\n", &config->playing_area_width);
-    fscanf(config_game, "playing_area_height %d\n", &config->playing_area_height);
-    fscanf(config_game, "number_of_friendly_cars %d\n", &config->number_of_friendly_cars);
-    fscanf(config_game, "number_of_hostile_cars %d\n", &config->number_of_hostile_cars);
-    fscanf(config_game, "number_of_stopping_cars %d\n", &config->number_of_stopping_cars);
+//Tick-stamped keys of one game, delta encoded: varint(tick delta << 3 | key code)
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    int last_tick;
+} Recording;
 
-    fclose(config_game);
-    return 0;
-}
+typedef enum
+{
+    EventMove,
+    EventPush,
+    EventHalt,
+    EventDeath,
+    EventWin,
+    EventKinds
+} EventKind;
+
+//One gameplay event, fixed size so the ring is a plain array
+typedef struct
+{
+    int tick;
+    int kind; // EventKind
+    int x;
+    int y;
+    int value; // samochod dla push i halt, punkty dla win
+} GameEvent;
 
-//Generate random number between min and max
-int get_random_number(int min, int max)
+//Single producer ring of events: the game thread only appends, the writer thread drains it to the file
+typedef struct
 {
-    return rand() % (max + 1 - min) + min;
-}
+    GameEvent *events;
+    uint64_t mask;
+    alignas(64) atomic<uint64_t> head; // zapisuje tylko watek gry
+    uint64_t cached_tail; // tail widziany przez watek gry, odczytywany ponownie dopiero gdy pierscien wyglada na pelny
+    long dropped; // zdarzenia odrzucone przy pelnym pierscieniu
+    alignas(64) atomic<uint64_t> tail; // zapisuje tylko watek zapisu
+    atomic<bool> stop;
+    FILE *file;
+    thread writer;
+} EventLog;
+
+//Position in a memory mapped recording
+typedef struct
+{
+    const unsigned char *pos;
+    const unsigned char *end;
+    int next_tick; // klatka nastepnego zdarzenia
+    int next_code; // kod nastepnego klawisza albo ReplayEnd
+    int end_tick; // klatka w ktorej skonczyl sie zapis
+    int outcome; // SimState zapisany na koncu
+    bool corrupt; // nieznany kod klawisza, zapis uciety w tym miejscu
+} ReplayReader;
+
+typedef enum
+{
+    ReplayUp,
+    ReplayDown,
+    ReplayLeft,
+    ReplayRight,
+    ReplayPush,
+    ReplayOther,
+    ReplayEnd = 7
+} ReplayCode;
+
+//Whole game state, independent of the terminal
+typedef struct
+{
+    GameConfig config;
+    Frog frog;
+    Finish finish;
+    Arena arena; // cala pamiec gry
+    uint64_t seed; // ziarno, z ktorego gra moze byc odtworzona
+    Rng rng;
+    Rng hostile_rng; // osobny strumien, tory wrogich samochodow nie zaleza od zaby
+    CarStore cars;
+    Lanes lanes;
+    Obstacle *obstacle;
+    int *used_flags;
+    int *row_car; // indeks samochodu na danym wierszu (-1 - brak)
+    int *roads; // y kolejnych drog
+    int *positions; // numery drog dla kolejnych samochodow
+    int *shuffle; // pomocnicza tablica do losowania drog i przeszkod bez powtorzen
+    Occupancy occupancy;
+    PushingCar push_car;
+    Recording *recording; // zapis wejscia (nullptr - bez zapisu)
+    EventLog *events; // zdarzenia dla analityki (nullptr - wylaczone)
+    int game_ticks;
+    int last_jump_tick;
+    SimState state;
+} Simulation;
+
+//Changing part of a game, trivially copyable; snapshot_size() bytes: this header, then one packed word per car
+typedef struct
+{
+    uint64_t seed; // plansza odtwarzana z ziarna
+    Rng rng;
+    Rng hostile_rng;
+    int32_t game_ticks;
+    int32_t last_jump_tick;
+    int32_t push_car_index;
+    int32_t frog_x;
+    int32_t frog_y;
+    uint32_t flags; // stan gry w bitach 0-1, samochod czeka na pchniecie w bicie 2
+} Snapshot;
+
+//Search results by state hash, one entry per slot
+typedef struct
+{
+    uint64_t *keys; // 0 oznacza puste pole
+    int *values;
+    size_t mask;
+} TranspositionTable;
 
-//Initialize color pairs
-void initialize_colors()
+//Scratch of the lookahead policy: one snapshot per search level and the results seen so far
+typedef struct
 {
-    start_color();
-    //           Foreground   Background
-    init_pair(1, COLOR_BLACK, COLOR_GREEN);   // Frog color
-    init_pair(2, COLOR_BLACK, COLOR_YELLOW);  // Street color
-    init_pair(3, COLOR_BLACK, COLOR_RED);     // Hostile car color
-    init_pair(4, COLOR_BLACK, COLOR_BLUE);    // Friendly car color
-    init_pair(5, COLOR_BLACK, COLOR_MAGENTA); // Stopping car color
-    init_pair(6, COLOR_BLACK, COLOR_WHITE);   // Obstacle color
+    unsigned char *snapshots;
+    size_t size; // snapshot_size gry
+    TranspositionTable table;
+    long nodes;
+    long hits;
+} Lookahead;
+
+//Binary min-heap of 64-bit keys with an int payload
+typedef struct
+{
+    uint64_t *keys;
+    int *values;
+    int size;
+    int capacity;
+} Heap;
 
-    init_pair(7, COLOR_WHITE, COLOR_BLACK); // Text color
-    init_pair(8, COLOR_RED, COLOR_BLACK);   // "FROGGER" color
-}
+//Stretch of a hostile lane with one speed: from tick on its car runs through the bounce cycle starting at phase
+typedef struct
+{
+    int tick;
+    int phase;
+    int speed;
+} LanePeriod;
 
+//Hostile lanes ahead of the game. A car bouncing between x = 1 and cols - 4 repeats its lane every cycle moves,
+//so the row mask of every phase is built once for all lanes, and a lane only gets a new period when a bounce
+//really changes its speed. Bounces are replayed lazily with a copy of the hostile rng
+typedef struct
+{
+    int cars;
+    int rows;
+    int cols;
+    int cycle; // ruchy tam i z powrotem
+    int words; // slowa maski jednego wiersza
+    uint64_t *masks; // kola samochodu w kazdej fazie cyklu
+    int *row_lane; // pas wrogiego samochodu na wierszu (-1 - brak)
+    LanePeriod **periods; // okresy kazdego pasa
+    int *count;
+    int *capacity;
+    int *cursor; // ostatnio uzyty okres pasa, zapytania ida zwykle do przodu w czasie
+    Heap events; // nastepne odbicia: klatka << 32 | numer pasa
+    Rng rng; // kopia generatora wrogich samochodow
+    int *batch; // pasy odbijajace sie w jednej klatce
+    int *roll;
+    int *new_speed;
+    long changes; // odbicia, ktore zmienily predkosc i zaczely nowy okres
+} Forecast;
+
+//Open addressing set of visited search states
+typedef struct
+{
+    uint64_t *keys; // (stan + 1) << 3 | klatki od skoku, 0 oznacza puste pole
+    size_t mask;
+    size_t count;
+} StateSet;
 
-//BOARD FUNCTIONS
+//Search state: frog position at the start of a tick and ticks since the last jump
+typedef struct
+{
+    int x;
+    int y;
+    int tick;
+    int parent;
+    short since_jump; // obciete do JumpDelayTicks
+    short key; // klawisz ktorym tu doszlismy (ERR - czekanie)
+} SolverNode;
 
-//Create game board window
-WINDOW *create_board(int BoardHeight, int BoardWidth)
+typedef struct
 {
-    int xMax, yMax; // zmienne do przechowywania terminala
-    getmaxyx(stdscr, yMax, xMax); // pobierania wysokosci i szerokosci terminala
+    bool headless;
+    long ticks;
+    const char *config_file;
+    uint64_t seed;
+    long montecarlo; // liczba gier do zasymulowania (0 - wylaczone)
+    int threads;
+    int policy;
+    const char *record_file;
+    const char *events_file; // dziennik zdarzen JSONL (nullptr - wylaczony)
+    const char *publish_file; // pamiec dzielona z klatkami dla widzow (nullptr - bez publikacji)
+    const char *spectate_file; // ogladanie gry opublikowanej przez inny proces
+    const char *replay_file;
+    bool bot;
+    long generate; // ile poziomow wygenerowac do paczki (0 - wylaczone)
+    const char *pack_file;
+    long level; // numer poziomu z paczki (-1 - z pliku konfiguracji)
+    const char *stats_file;
+    bool overlay;
+    bool bench;
+    const char *serve; // port TCP albo sciezka gniazda Unix (nullptr - bez serwera)
+    bool ansi; // rysowanie przez wlasny bufor ANSI zamiast ncurses
+    long envbench; // liczba srodowisk w tescie predkosci VecEnv (0 - wylaczone)
+    double speed; // skala czasu gry (0 - domyslna dla trybu)
+    bool endless; // plansza bez konca niezaleznie od pliku konfiguracji
+    bool threaded; // symulacja i rysowanie w osobnych watkach
+} Options;
+
+typedef enum
+{
+    PolicyRandom,
+    PolicyCautious,
+    PolicyLookahead
+} FrogPolicy;
 
-    refresh();
-    // tworzenie okna z wymiarami BoardHeight x BoardWidth, umieszczenia okna w srodku terminala, obliczenie wspolrzednych jego srodka
-    WINDOW *board_win = newwin(BoardHeight, BoardWidth, (yMax / 2) - (BoardHeight / 2), (xMax / 2) - (BoardWidth / 2));
+//Parts of a frame that are timed
+typedef enum
+{
+    PhaseInput,
+    PhaseTick,
+    PhaseDraw,
+    PhaseOutput,
+    PhaseFrame,
+    PhaseLatency, // od nadejscia klawisza do wyslania ekranu
+    PhaseMove, // od odczytania strzalki do skoku zaby (czekanie na koniec poprzedniego skoku)
+    Phases
+} Phase;
+
+//Log-linear histogram of nanoseconds: fixed size, constant time to record
+typedef struct
+{
+    uint64_t counts[HistogramBuckets];
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+} Histogram;
 
-    if (!board_win) // czy udalo sie utworzyc okno
-    {
-        printw("Error: Could not create board window\n");
-        refresh();
-        return nullptr;
-    }
+typedef struct
+{
+    Histogram phase[Phases];
+    long long pending_input; // kiedy przyszedl klawisz jeszcze niewidoczny na ekranie (0 - brak)
+    long coalesced_moves; // strzalki zastapione nowsza zanim zaba skoczyla
+    long dropped_keys; // klawisze, ktore nie zmiescily sie w kolejce
+    bool overlay; // wypisywanie statystyk obok display_info
+} FrameStats;
+
+//Cells of a terminal for the ANSI backend: color pair << 8 | glyph
+typedef struct
+{
+    int rows;
+    int cols;
+    uint16_t *base; // statyczna warstwa planszy (serwer)
+    uint16_t *cells; // bufor tylny: klatka skladana teraz
+    uint16_t *shown; // bufor przedni: co terminal juz ma na ekranie
+    int color; // ostatni wyslany kolor (-1 - nieznany)
+    char *out; // zakodowane zmiany czekajace na wyslanie
+    size_t out_used;
+    size_t out_capacity;
+    int fd; // dokad present_frame pisze klatke (-1 - serwer wysyla sam)
+} AnsiScreen;
+
+//Start of the shared memory file of --publish: the game to rebuild and the number of the newest frame
+typedef struct
+{
+    char magic[4]; // "JFSP"
+    int version;
+    uint64_t seed;
+    GameConfig config;
+    int frame_ints; // rozmiar jednej klatki w liczbach int
+    int slot_size; // bajty jednego miejsca w pierscieniu razem z numerem sekwencji
+    atomic<uint64_t> published; // numer najnowszej gotowej klatki (0 - jeszcze zadnej)
+    atomic<int> closed; // gra sie skonczyla, nowych klatek nie bedzie
+} SpectatorHeader;
+
+//Mapped frame ring: the game writes every refresh, any number of spectators read the newest frame
+typedef struct
+{
+    SpectatorHeader *header;
+    size_t size; // caly zmapowany plik
+    uint64_t frame; // wydawca: ostatnia opublikowana klatka, widz: ostatnia przeczytana
+    int *copy; // widz: spojna kopia klatki poza pamiecia dzielona
+} SpectatorRing;
 
-    box(board_win, 0, 0); // rysowanie ramki board_win dla domyslnych znakow
-    wrefresh(board_win); // odswiezanie okna by wyswietlic ramke
-    return board_win;
-}
+//What is currently on the screen, so only changed cells get redrawn
+typedef struct
+{
+    int rows;
+    int cols;
+    chtype *static_cells; // ramka, drogi, meta i przeszkody zbudowane raz
+    int *car_pair; // kolor kazdego samochodu
+    int *drawn_car_x; // gdzie samochod jest narysowany
+    Frog drawn_frog; // gdzie zaba jest narysowana
+    int drawn_time; // czas wypisany w display_info
+    int top; // wiersz swiata na gorze narysowanej warstwy statycznej
+    FrameStats *stats; // pomiary czasu klatki (nullptr - wylaczone)
+    AnsiScreen *ansi; // backend ANSI zamiast ncurses (nullptr - ncurses)
+    SpectatorRing *spectators; // kazda klatka idzie tez do widzow (nullptr - bez publikacji)
+} Renderer;
+
+//Virtual game time: real time times the scale, cut into fixed FrameDelay ticks
+typedef struct
+{
+    long long real_last; // ostatni odczyt zegara monotonicznego (us)
+    double accumulator; // czas wirtualny jeszcze nie zamieniony na ticki (us)
+    double scale; // ile razy szybciej niz w rzeczywistosci
+} GameClock;
 
-//Draw board borders
-void draw_board(WINDOW *board_win)
+//One key read from the terminal, stamped with the time it was read
+typedef struct
 {
-    box(board_win, 0, 0); // narysuj ramke dla boardwin
-}
+    int key;
+    long long time; // monotonic_nsec
+} InputEvent;
 
-//Display game information
-void display_info(WINDOW *board_win, int elapsed_time, GameConfig config)
+//Keys waiting to be applied in order: a move waits for the jump cooldown instead of being dropped
+typedef struct
 {
-    int x, y;
-    getbegyx(board_win, y, x);
-    int width = getmaxx(board_win);
+    InputEvent events[InputQueueSize]; // pierscien od head
+    int head;
+    int count;
+    long coalesced; // strzalki zastapione nowsza
+    long dropped; // klawisze odrzucone przy pelnej kolejce
+} InputQueue;
+
+//Three frames between the simulation thread and the render thread: the writer always has a free frame to fill,
+//the reader swaps out the newest one, nobody waits for anybody
+typedef struct
+{
+    int *frames; // trzy klatki po frame_ints liczb
+    int frame_ints;
+    int back; // zapisuje tylko watek symulacji
+    int front; // czyta tylko watek rysujacy
+    alignas(64) atomic<int> middle; // gotowa klatka | TripleFresh
+} TripleBuffer;
+
+//Keys from the render thread to the simulation thread, single producer and single consumer
+typedef struct
+{
+    InputEvent events[InputQueueSize];
+    alignas(64) atomic<uint32_t> head; // zapisuje tylko watek rysujacy
+    alignas(64) atomic<uint32_t> tail; // zapisuje tylko watek symulacji
+    long dropped; // klawisze odrzucone przy pelnym pierscieniu
+} KeyRing;
 
-    int start_x = x + width + 5;
+//State of --threaded: the simulation thread owns the game, the render thread only sees published frames
+typedef struct
+{
+    Simulation *sim;
+    ReplayReader *reader; // nullptr - klawisze gracza
+    double scale;
+    FrameStats stats; // tick i ruch mierzone w watku symulacji, dolaczane do statystyk na koncu gry
+    bool measure;
+    InputQueue queue;
+    KeyRing keys;
+    TripleBuffer frames;
+    int wake[2]; // rysujacy budzi symulacje po klawiszu
+    int published[2]; // symulacja budzi rysujacego po nowej klatce
+    atomic<bool> quit; // gracz wyszedl klawiszem 'o'
+    atomic<bool> finished; // gra rozstrzygnieta albo zapis skonczony, ostatnia klatka opublikowana
+} SimThread;
 
-    if (start_x + 20 > COLS)
+//Load configuration from file
+int load_config(const char *file, GameConfig *config)
+{
+    FILE *config_game = fopen(file, "r");
+    if (config_game == nullptr)
     {
-        mvprintw(TextHeight, start_x, "Info Area Overflow");
-        return;
+        perror("Cannot open config file");
+        return 1;
     }
 
-    attron(COLOR_PAIR(7));
-    mvprintw(TextHeight, start_x, "Name: %s", "Karol");
-    mvprintw(TextHeight + 1, start_x, "Surname: %s", "Obrycki");
-    mvprintw(TextHeight + 2, start_x, "Index: %d", 203264);
-    mvprintw(TextHeight + 3, start_x, "Time: %d seconds", elapsed_time);
-    attroff(COLOR_PAIR(7));
-}
-
-//Display "FROGGER" text
-void frogger_text(WINDOW *board_win)
-{//wypisanie napisu FROGGER na samym srodku na gorze
-    int xMax, yMax;
-    getbegyx(board_win, yMax, xMax);
-    int width = getmaxx(board_win);
-
-    attron(COLOR_PAIR(8));
-    mvprintw(yMax - 2, xMax + (width - strlen("FROGGER")) / 2 + 1, "FROGGER");
-    attroff(COLOR_PAIR(8));
-}
-
-
-//ENDING FUNCTIONS
-
-//Initialize finish area
-void creare_finish(WINDOW *board_win, Finish *finish, GameConfig config)
-{   //wspolrzedne dla konca gry
-    finish->x = config.playing_area_width / 2;
-    finish->y = 1;
+    config->number_of_roads = RoadNumber; // wartosci domyslne dla starych plikow konfiguracji
+    config->number_of_obstacles = ObstacleNumber;
+    config->endless = 0;
 
-    //wyrysuj koniec gry
-    wattron(board_win, COLOR_PAIR(1));
-    mvwprintw(board_win, finish->y, finish->x, " ");
-    wattroff(board_win, COLOR_PAIR(1));
-}
+    char key[64];
+    int value;
+    while (fscanf(config_game, "%63s %d", key, &value) == 2) // kolejne pary "klucz wartosc"
+    {
+        if (strcmp(key, "playing_area_width") == 0)
+            config->playing_area_width = value;
+        else if (strcmp(key, "playing_area_height") == 0)
+            config->playing_area_height = value;
+        else if (strcmp(key, "number_of_friendly_cars") == 0)
+            config->number_of_friendly_cars = value;
+        else if (strcmp(key, "number_of_hostile_cars") == 0)
+            config->number_of_hostile_cars = value;
+        else if (strcmp(key, "number_of_stopping_cars") == 0)
+            config->number_of_stopping_cars = value;
+        else if (strcmp(key, "number_of_roads") == 0)
+            config->number_of_roads = value;
+        else if (strcmp(key, "number_of_obstacles") == 0)
+            config->number_of_obstacles = value;
+        else if (strcmp(key, "endless") == 0)
+            config->endless = value != 0;
+        else
+            fprintf(stderr, "Unknown config key: %s\n", key);
+    }
 
-//Check if frog has reached the finish
-bool check_finish_collision(Frog *frog, Finish *finish)
-{
-    return (frog->x == finish->x && frog->y == finish->y);
+    fclose(config_game);
+    return 0;
 }
 
-void display_win_message(WINDOW *board_win, int elapsed_time, GameConfig config)
+//Check that everything in the config fits on the board
+int validate_config(GameConfig *config)
 {
-    int rows, cols;
-    getmaxyx(board_win, rows, cols);
-
-    const char *message = "You Won!";
-    int x = (cols - strlen(message)) / 2;
-    int y = rows / 2;
+    int rows = config->playing_area_height;
+    int cars = config->number_of_hostile_cars + config->number_of_friendly_cars + config->number_of_stopping_cars;
 
-    wattron(board_win, A_BOLD);
-    mvwprintw(board_win, y, x, "%s", message);
-    mvwprintw(board_win, y + 1, x - 5, "You've got %d points", config.playing_area_width / elapsed_time * 3);
-    wattroff(board_win, A_BOLD);
-    wrefresh(board_win);
-    usleep(2000000);
+    if (config->playing_area_width < 10 || rows < 10)
+    {
+        fprintf(stderr, "Config error: playing area must be at least 10 x 10\n");
+        return 1;
+    }
+    if (config->number_of_roads < 0 || config->number_of_roads > rows - RoadHeight - 4) // drogi od 2 do rows - 4
+    {
+        fprintf(stderr, "Config error: at most %d roads fit on the board\n", rows - RoadHeight - 4);
+        return 1;
+    }
+    int lane_capacity = (config->playing_area_width - 5) / LaneGap; // x od 1 do width - 4 i jedno wolne pole, zeby pelny pas jechal
+    if (cars > config->number_of_roads * lane_capacity || config->number_of_hostile_cars < 0 ||
+        config->number_of_friendly_cars < 0 || config->number_of_stopping_cars < 0)
+    {
+        fprintf(stderr, "Config error: %d cars do not fit on %d roads (%d per road)\n", cars, config->number_of_roads, lane_capacity);
+        return 1;
+    }
+    if (config->number_of_obstacles < 0 || config->number_of_obstacles > rows - 7 - config->number_of_roads) // przeszkody od 3 do rows - 5, nie na drogach
+    {
+        fprintf(stderr, "Config error: at most %d obstacles fit between the roads\n", rows - 7 - config->number_of_roads);
+        return 1;
+    }
+    return 0;
 }
 
-void display_lose_message(WINDOW *board_win)
+//Little endian integer, the same on every machine
+void write_int(FILE *file, uint64_t value, int bytes)
 {
-    int rows, cols;
-    getmaxyx(board_win, rows, cols);
-
-    const char *message = "You Lose!";
-    int x = (cols - strlen(message)) / 2 + 1;
-    int y = rows / 2;
-
-    wattron(board_win, A_BOLD);
-    mvwprintw(board_win, y, x, "%s", message);
-    wattroff(board_win, A_BOLD);
-    wrefresh(board_win);
-    usleep(2000000);
+    for (int i = 0; i < bytes; i++)
+    {
+        fputc((int)((value >> (8 * i)) & 0xFF), file);
+    }
 }
 
-
-
-//ROAD FUNCTIONS
-
-//Initialize road flags
-void initialize_flags(int *flags, int size)
+uint64_t read_int(const unsigned char *data, int bytes)
 {
-    for (int i = 0; i < size; i++)
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
     {
-        flags[i] = 0;
+        value |= (uint64_t)data[i] << (8 * i);
     }
+    return value;
 }
 
-//Check roads collision
-bool is_roads_collision(int *flags, int road_y, int road_height, int rows)
+//Config in binary files (recordings, level packs): seven 32-bit fields
+void config_write(FILE *file, GameConfig *config)
 {
-    if (road_y < 0 || road_y >= rows) // sprawdzanie czy droga jest w obszarze planszy
+    int values[] = {config->playing_area_width, config->playing_area_height, config->number_of_friendly_cars,
+                    config->number_of_hostile_cars, config->number_of_stopping_cars, config->number_of_roads,
+                    config->number_of_obstacles};
+    for (int value : values)
     {
-        return true;
+        write_int(file, (uint32_t)value, 4);
     }
-    return flags[road_y] != 0; // sprawdzanie czy droga jest juz zajeta (!= 0 == true, my chcemy false)
 }
 
-//Mark a road for checking the collision
-void mark_road(int *flags, int road_y, int road_height, int rows)
+void config_read(const unsigned char *data, GameConfig *config)
 {
-    if (road_y >= 0 && road_y < rows) // czy droga w obszarze planszy
+    int *values[] = {&config->playing_area_width, &config->playing_area_height, &config->number_of_friendly_cars,
+                     &config->number_of_hostile_cars, &config->number_of_stopping_cars, &config->number_of_roads,
+                     &config->number_of_obstacles};
+    for (int i = 0; i < 7; i++)
     {
-        flags[road_y] = 1; // oznaczamy nowa droge
+        *values[i] = (int)(int32_t)read_int(data + 4 * i, 4);
     }
+    config->endless = 0; // nie jest czescia zapisanej konfiguracji, zapis gry ma go w bajcie flag
 }
 
-void draw_one_road(WINDOW *board_win, int road_y, int cols)
+//Take an aligned piece of the arena, or only count the bytes when the arena has no memory yet
+void *arena_alloc(Arena *arena, size_t bytes)
 {
-    wattron(board_win, COLOR_PAIR(2)); // ustawienie koloru dla drogi w board_win
-    for (int x = 0; x < cols - 2; x++) // rysowanie drogi
+    size_t start = (arena->used + 63) & ~(size_t)63; // wyrownanie do linii cache
+    arena->used = start + bytes;
+    if (arena->base == nullptr)
     {
-        mvwprintw(board_win, road_y, x + 1, " ");
+        return nullptr;
     }
-    wattroff(board_win, COLOR_PAIR(2)); // wylaczenie koloru drogi dla board_win
+    return arena->base + start;
 }
 
-//Draw all roads
-void draw_roads(int *used_flags, WINDOW *board_win, int rows, int cols)
-{   //rysowanie drogi dla wspolrzednych y z tablicy
-    for (int y = 0; y < rows; y++)
+//Seed the generator, splitmix64 spreads the seed over the whole state
+void rng_seed(Rng *rng, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
     {
-        if (used_flags[y] == 1)
-        {
-            draw_one_road(board_win, y, cols);
-        }
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        rng->s[i] = z ^ (z >> 31);
     }
 }
 
-void get_random_road(int *used_flags, int rows)
+uint64_t rng_next(Rng *rng)
 {
-    srand(time(NULL));
+    uint64_t *s = rng->s;
+    uint64_t x = s[1] * 5;
+    uint64_t result = ((x << 7) | (x >> 57)) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+}
 
-    int road_count = 0;
+//Generate random number between min and max
+int get_random_number(Rng *rng, int min, int max)
+{
+    uint64_t range = (uint64_t)(max + 1 - min);
+    return (int)(((rng_next(rng) >> 32) * range) >> 32) + min; // mnozenie zamiast modulo
+}
 
-    while (road_count < RoadNumber)
+//Generate a whole batch of random numbers between min and max
+void fill_random(Rng *rng, int *out, int count, int min, int max)
+{
+    uint64_t range = (uint64_t)(max + 1 - min);
+    int i = 0;
+    for (; i + 1 < count; i += 2) // jedno 64-bitowe losowanie daje dwie liczby
+    {
+        uint64_t r = rng_next(rng);
+        out[i] = (int)(((r >> 32) * range) >> 32) + min;
+        out[i + 1] = (int)(((r & 0xFFFFFFFFULL) * range) >> 32) + min;
+    }
+    if (i < count)
     {
-        int road_y = rand() % (rows - RoadHeight - 4) + 2; // Generowanie dróg od 2 do rows - 2
+        out[i] = get_random_number(rng, min, max);
+    }
+}
 
-        //Check if there is already a road in this position
-        if (is_roads_collision(used_flags, road_y, RoadHeight, rows))
-        {
-            continue;
-        }
+//Initialize color pairs
+void initialize_colors()
+{
+    start_color();
+    //           Foreground   Background
+    init_pair(1, COLOR_BLACK, COLOR_GREEN);   // Frog color
+    init_pair(2, COLOR_BLACK, COLOR_YELLOW);  // Street color
+    init_pair(3, COLOR_BLACK, COLOR_RED);     // Hostile car color
+    init_pair(4, COLOR_BLACK, COLOR_BLUE);    // Friendly car color
+    init_pair(5, COLOR_BLACK, COLOR_MAGENTA); // Stopping car color
+    init_pair(6, COLOR_BLACK, COLOR_WHITE);   // Obstacle color
 
-        mark_road(used_flags, road_y, RoadHeight, rows);
-        road_count++;
-    }
+    init_pair(7, COLOR_WHITE, COLOR_BLACK); // Text color
+    init_pair(8, COLOR_RED, COLOR_BLACK);   // "FROGGER" color
 }
 
 
-//OBSTACLE FUNCTIONS
+//ANSI FUNCTIONS
 
-void initialize_obstacle(Obstacle *obstacles, const int *used_flags, int rows, int cols)
+//Box drawing glyphs stored below ' ' in the cells, the other glyphs are plain ASCII
+const char *ansi_glyphs[] = {" ", "\xe2\x94\x80", "\xe2\x94\x82", "\xe2\x94\x8c", "\xe2\x94\x90", "\xe2\x94\x94", "\xe2\x94\x98"};
+enum
 {
-    int obstacle_i = 0; //indeks przeszkody z tablicy obstacles[]
-    int obstacle_count = 0; //liczymy przeszkody
-
-    bool check_k[rows] = {false}; //tablica boolow ktore wiesze dla przeszkod sa juz zajete
+    GlyphHLine = 1,
+    GlyphVLine,
+    GlyphUlCorner,
+    GlyphUrCorner,
+    GlyphLlCorner,
+    GlyphLrCorner
+};
+
+//Foreground and background of the pairs from initialize_colors, pair 0 is the default
+const int ansi_colors[][2] = {{7, 0}, {0, 2}, {0, 3}, {0, 1}, {0, 4}, {0, 5}, {0, 7}, {7, 0}, {1, 0}};
+
+uint16_t ansi_cell(int pair, int glyph)
+{
+    return (uint16_t)(pair << 8 | glyph);
+}
 
-    while (obstacle_count < ObstacleNumber)
+void ansi_put(AnsiScreen *screen, const char *data, size_t size)
+{
+    if (screen->out_used + size > screen->out_capacity)
     {
-        int k = rand() % rows; // losowanie y dla przeszkody
-        if (used_flags[k] != 0 || check_k[k] == true) // sprawdzamy czy droga wynosi 1 lub juz jest na niej przeszkoda
+        size_t capacity = screen->out_capacity ? screen->out_capacity : 4096;
+        while (capacity < screen->out_used + size)
         {
-            continue;
+            capacity *= 2;
         }
-        if (k > rows - 5 || k < 3) //drugie sprawczenie czy y dla preszkody miesci sie w zakresie planszy
+        char *out = (char *)realloc(screen->out, capacity);
+        if (out == nullptr)
         {
-            continue;
+            return; // terminal dostanie niepelna klatke, nastepna ja poprawi
         }
-        obstacles[obstacle_i].y = k; //y dla przeszkody
-        obstacles[obstacle_i].x = rand() % (cols - 6) + 1; // losowanie x dla przeszkody
-        obstacle_i++; // przechodzimy do indeksu nastepnej przeszkody
-        check_k[k] = true; //dajemy jej y na true
-        obstacle_count++; // liczymy przeszkody
+        screen->out = out;
+        screen->out_capacity = capacity;
     }
+    memcpy(screen->out + screen->out_used, data, size);
+    screen->out_used += size;
 }
 
-void draw_obstacles(WINDOW *board_win, Obstacle *obstacles, int obstacle_count)
+void ansi_text(AnsiScreen *screen, int y, int x, int pair, const char *text)
 {
-    for (int i = 0; i < obstacle_count; i++)
+    for (; *text && x < screen->cols; text++, x++)
     {
-        wattron(board_win, COLOR_PAIR(6)); // wlaczamy kolor dla board_win
-        mvwprintw(board_win, obstacles[i].y, obstacles[i].x, "#"); // rysowanie danej przeszkody
-        wattroff(board_win, COLOR_PAIR(6)); // wlaczamy kolor dla board_win
+        if (y >= 0 && y < screen->rows && x >= 0)
+        {
+            screen->cells[y * screen->cols + x] = ansi_cell(pair, (unsigned char)*text);
+        }
     }
 }
 
-//Check collision with the frog and obstacles
-bool check_collision_obstacle(Frog *frog, Obstacle *obstacles, int obstacle_count)
-{ // sprawdzenie czy zaba nie bedzie wchodzi na przeszkode
-    for (int i = 0; i < obstacle_count; i++)
-    {
-        if ((frog->x == obstacles[i].x && frog->y == obstacles[i].y) ||
-            (frog->x == obstacles[i].x && frog->y + 1 == obstacles[i].y))
-        {
-            return true;
-        }
-    }
-    return false;
-}
-
-
-//CARS FUNCTIONS
-
-void initialize_cars(Car *cars, const int *used_flags, int rows, int cols)
+//Convert an ncurses cell: color pair and, for the line characters of the border, a box glyph
+uint16_t ansi_chtype(chtype cell)
 {
-    int car_i = 0; // liczby samochody
-
-    for (int i = 0; i < rows; i++)
+    int glyph = (int)(cell & A_CHARTEXT);
+    if (cell & A_ALTCHARSET)
     {
-        if (used_flags[i] != 1) // jesli droga nie jest zainicjalizowana kontynnuj
-        {
-            continue;
-        }
-        cars[car_i].y = i; // wiersz y dla samochodu
-        cars[car_i].x = get_random_number(4, cols - 6); // losowanie x dla samochodu pomiedzy 4 a cols - 6
-        cars[car_i].direction = (rand() % 2 == 0) ? 1 : -1; // losujemy kierunek dla samochodu (1 - prawo, -1 - lewo)
-        cars[car_i].speed = get_random_number(1, 3); // losowanie predkosci samochodu
-        car_i++;
-        if (car_i >= RoadNumber) // sprawdzanie czy juz zainicjalizowano wszystkie samochody
-        {
-            break;
-        }
+        const char *lines = "qxlkmj"; // kolejnosc jak w Glyph*
+        const char *found = glyph != 0 ? strchr(lines, glyph) : nullptr;
+        glyph = found != nullptr ? GlyphHLine + (int)(found - lines) : ' ';
     }
+    return ansi_cell(PAIR_NUMBER(cell), glyph != 0 ? glyph : ' ');
 }
 
-//Initialize car colors and positions
-void initialize_car_colors(GameConfig config, int *hostile_positions, int *friendly_positions, int *stopping_positions)
+//Blank back buffer; nothing is known about the terminal, so the next frame repaints every cell
+void ansi_clear(AnsiScreen *screen)
 {
-    static bool initialized = false; //kod wykona sie raz
-
-    if (!initialized)
+    size_t count = (size_t)screen->rows * screen->cols;
+    for (size_t i = 0; i < count; i++)
     {
-        bool if_placed[RoadNumber] = {false}; // tablica czy droga juz jest na danym y
-
-        int car_count1 = 0, car_count2 = 0, car_count3 = 0; // zliczanie drog dla poszczegolnych kolorow samochodow
-
-        while (car_count1 < config.number_of_hostile_cars) // wrogie samochody
-        {
-            int k = rand() % RoadNumber;
-            if (!if_placed[k]) // losujemy caly czas drogi az znajdziemy taka na ktorej jeszcze nie ma samochodu
-            {
-                if_placed[k] = true; // oznaczamy droge jako zajeta
-                hostile_positions[car_count1] = k; // oznaczamy y dla wrogiego samochodu
-                car_count1++; // zwiekszamy jego liczbe
-            }
-        }
-
-        while (car_count2 < config.number_of_friendly_cars)
-        {
-            int k = rand() % RoadNumber;
-            if (!if_placed[k])
-            {
-                if_placed[k] = true;
-                friendly_positions[car_count2] = k;
-                car_count2++;
-            }
-        }
-
-        while (car_count3 < config.number_of_stopping_cars)
-        {
-            int k = rand() % RoadNumber;
-            if (!if_placed[k])
-            {
-                if_placed[k] = true;
-                stopping_positions[car_count3] = k;
-                car_count3++;
-            }
-        }
-        initialized = true; // dajemy ze juz wykonalismy ta funcje
+        screen->cells[i] = ansi_cell(0, ' ');
+        screen->shown[i] = 0xFFFF;
     }
+    screen->color = -1;
 }
 
-//Draw all cars
-void draw_cars(WINDOW *board_win, Car *cars, GameConfig config, int *hostile_positions, int *friendly_positions, int *stopping_positions)
+bool ansi_screen_alloc(AnsiScreen *screen, int rows, int cols)
 {
-    initialize_car_colors(config, hostile_positions, friendly_positions, stopping_positions);
-
-    //Draw hostile cars (Red)
-    for (int i = 0; i < config.number_of_hostile_cars; i++)
-    {
-        wattron(board_win, COLOR_PAIR(3)); // wlaczamy kolor dla board_win
-        mvwprintw(board_win, cars[hostile_positions[i]].y, cars[hostile_positions[i]].x, "o-o"); // rysujemy wrogi samochod na danej pozycji y i x
-        wattroff(board_win, COLOR_PAIR(3));
-    }
-
-    //Draw friendly cars (Blue)
-    for (int i = 0; i < config.number_of_friendly_cars; i++)
+    screen->rows = rows;
+    screen->cols = cols;
+    size_t count = (size_t)rows * cols;
+    screen->base = (uint16_t *)calloc(count * 3, sizeof(uint16_t));
+    if (screen->base == nullptr)
     {
-        wattron(board_win, COLOR_PAIR(4));
-        mvwprintw(board_win, cars[friendly_positions[i]].y, cars[friendly_positions[i]].x, "o-o");
-        wattroff(board_win, COLOR_PAIR(4));
+        return false;
     }
-
-    //Draw stopping cars (Magenta)
-    for (int i = 0; i < config.number_of_stopping_cars; i++)
+    screen->cells = screen->base + count;
+    screen->shown = screen->cells + count;
+    screen->fd = -1;
+    for (size_t i = 0; i < count; i++)
     {
-        wattron(board_win, COLOR_PAIR(5));
-        mvwprintw(board_win, cars[stopping_positions[i]].y, cars[stopping_positions[i]].x, "o-o");
-        wattroff(board_win, COLOR_PAIR(5));
+        screen->base[i] = ansi_cell(0, ' ');
     }
+    ansi_clear(screen);
+    return true;
 }
 
-//Move all cars
-void move_hostile_cars(Car *cars, GameConfig config, int *hostile_positions, int game_ticks)
+void ansi_screen_free(AnsiScreen *screen)
 {
-    int cols = config.playing_area_width; // szerokosc planszy
-
-    for (int i = 0; i < config.number_of_hostile_cars; i++) // wszystkie wrogie samochody
-    {
-        int temp = hostile_positions[i]; // y tego samochodu
-
-        if (game_ticks % cars[temp].speed == 0) // poruszanie sie co odpowiedni czas w zaleznosci od swojej predkosci
-        {
-            if (cars[temp].x <= 1 || cars[temp].x + 3 >= cols - 1) // sprawdzamy krawedzie planszy
-            {
-                if (get_random_number(1, 4) == 1) // 25% szans ze zmieni predkosc
-                {
-                    cars[temp].speed = get_random_number(1, 3); // losuje nowa predkosc
-                }
-                cars[temp].direction *= -1; // jak dotarl do krawedzi zmienia kierunek
-            }
-            cars[temp].x += cars[temp].direction; // poruszamy samochod
-        }
-    }
+    free(screen->base);
+    free(screen->out);
+    screen->base = nullptr;
+    screen->out = nullptr;
+    screen->out_used = screen->out_capacity = 0;
 }
 
-void move_friendly_cars(Car *cars, GameConfig config, int *friendly_positions, int game_ticks, Frog *frog, PushingCar *push_car)
+//Cursor move sequence without printf: ESC [ y ; x H
+void ansi_put_move(AnsiScreen *screen, int y, int x)
 {
-    int cols = config.playing_area_width; // szerokosc planszy
-
-    for (int i = 0; i < config.number_of_friendly_cars; i++) // wszystkie przyjazne samochody
+    char sequence[24] = "\x1b[";
+    int length = 2, values[] = {y, x};
+    for (int value : values)
     {
-        int temp = friendly_positions[i]; // y tego przyjaznego
-
-        if (push_car->waiting_to_push && push_car->car_index == temp) // jesli samochod akurat czeka na przesuniecie i jego y sie zgadza
+        char digits[12];
+        int count = 0;
+        do
         {
-            if (!(
-                    (frog->y == cars[temp].y && frog->x >= cars[temp].x && frog->x <= cars[temp].x + 2) ||
-                    (frog->y + 1 == cars[temp].y && frog->x >= cars[temp].x && frog->x <= cars[temp].x + 2))) //sprawdzenie czy zaba jest w odpowiedniej pozycji na przepchniecie
-            {
-                push_car->waiting_to_push = 0; // jesli nie to resetujemy push_car
-                push_car->car_index = -1;
-            }
-            else
-            {
-                continue; // jesli tak to lecimy
-            }
-        }
-
-        if (game_ticks % cars[temp].speed == 0) // poruszanie sie co odpowiedni czas w zaleznosci od swojej predkosci
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0)
         {
-            cars[temp].x += cars[temp].direction; // poruszamy samochod
-
-            if (cars[temp].x <= 1 || cars[temp].x + 3 >= cols - 1) // sprawdzanie granicy planszy
-            {
-                if (get_random_number(1, 4) == 1) // 25% szans na zmiane predkosci
-                {
-                    cars[temp].speed = get_random_number(1, 3);
-                }
-
-                if (get_random_number(1, 2) == 1) // 50% szans na pojawienie sie z drugiej strony planszy
-                {
-                    if (cars[temp].x >= cols - 3) // teleportacja
-                    {
-                        cars[temp].x = 1;
-                    }
-                    else if (cars[temp].x < 1) // teleportacja
-                    {
-                        cars[temp].x = cols - 4;
-                    }
-                }
-                else
-                {
-                    cars[temp].direction *= -1; // zmiana kierunku
-                }
-            }
+            sequence[length++] = digits[--count];
         }
+        sequence[length++] = ';';
     }
+    sequence[length - 1] = 'H';
+    ansi_put(screen, sequence, length);
 }
 
-void move_stopping_cars(Car *cars, GameConfig config, int *stopping_positions, int game_ticks, Frog *frog)
+//Encode the cells that differ from what the client shows: cursor moves only where runs break
+void ansi_flush_frame(AnsiScreen *screen)
 {
-    int cols = config.playing_area_width; // szerokosc planszy
-
-    for (int i = 0; i < config.number_of_stopping_cars; i++) // wszystkie stopping cars
+    int count = screen->rows * screen->cols, cursor = -1;
+    for (int i = 0; i < count; i++)
     {
-        int temp = stopping_positions[i]; // y tego aktualnego stopping
-
-        // Calculate distance to frog
-        int distance1 = abs(cars[temp].x - frog->x) + abs(cars[temp].y - frog->y); // liczenie odleglosci1
-        int distance2 = abs(cars[temp].x - frog->x + 2) + abs(cars[temp].y - frog->y); // liczenie odleglosci2
-
-        if (distance1 <= StoppingDistance || distance2 <= StoppingDistance) // jesli distance odpowiednio maly
+        if (i + 4 <= count && memcmp(screen->cells + i, screen->shown + i, 4 * sizeof(uint16_t)) == 0) // cztery rowne pola naraz
         {
-            cars[temp].is_static = true; // zatrzymujemy samochod
-            continue; // samochod nie moze sie ruszyc
+            i += 3;
+            continue;
         }
-        else
+        uint16_t cell = screen->cells[i];
+        if (cell == screen->shown[i])
         {
-            cars[temp].is_static = false; // jezdzi dalej
+            continue;
         }
-
-        if (game_ticks % cars[temp].speed == 0) // poruszanie sie co odpowiedni czas w zaleznosci od swojej predkosci
+        if (i != cursor)
         {
-            cars[temp].x += cars[temp].direction; // poruszamy samochod
-            if (get_random_number(1, 4) == 1) // 25% szans na zmiane predkosci
-            {
-                cars[temp].speed = get_random_number(1, 3); // zmiana predkosci
-            }
+            ansi_put_move(screen, i / screen->cols + 1, i % screen->cols + 1);
         }
-
-        if (cars[temp].x >= cols - 3) // teleportacja
+        int color = cell >> 8;
+        if (color != screen->color)
+        {
+            char sequence[] = {'\x1b', '[', '3', (char)('0' + ansi_colors[color][0]), ';', '4', (char)('0' + ansi_colors[color][1]), 'm'};
+            ansi_put(screen, sequence, sizeof(sequence));
+            screen->color = color;
+        }
+        int glyph = cell & 0xFF;
+        if (glyph < ' ')
         {
-            cars[temp].x = 1;
+            ansi_put(screen, ansi_glyphs[glyph], strlen(ansi_glyphs[glyph]));
         }
-        else if (cars[temp].x < 1) // teleportacja
+        else
         {
-            cars[temp].x = cols - 4;
+            char c = (char)glyph;
+            ansi_put(screen, &c, 1);
         }
+        screen->shown[i] = cell;
+        cursor = (i + 1) % screen->cols == 0 ? -1 : i + 1; // na koncu wiersza nie liczymy na zawijanie
     }
 }
 
-
-//Move cars based on speed and direction
-void move_cars(Car *cars, GameConfig config, int *hostile_positions, int *friendly_positions, int *stopping_positions, int game_ticks, Frog *frog, PushingCar *push_car)
-{
-    move_hostile_cars(cars, config, hostile_positions, game_ticks);
-    move_friendly_cars(cars, config, friendly_positions, game_ticks, frog, push_car);
-    move_stopping_cars(cars, config, stopping_positions, game_ticks, frog);
-
-}
-
-//Check collision between frog and hostile cars
-bool check_collision_hostile_car(Frog *frog, Car *cars, GameConfig config, int *hostile_positions)
+//Board cells go to the ncurses window or to the back buffer at the window's position
+void put_cells(WINDOW *win, Renderer *renderer, int y, int x, const chtype *cells, int count)
 {
-    for (int i = 0; i < config.number_of_hostile_cars; i++) //sprawdzenie wszystkich wrogich samochodow
+    AnsiScreen *screen = renderer->ansi;
+    if (screen == nullptr)
+    {
+        mvwaddchnstr(win, y, x, cells, count);
+        return;
+    }
+    int top, left;
+    getbegyx(win, top, left);
+    y += top;
+    x += left;
+    if (y < 0 || y >= screen->rows)
+    {
+        return;
+    }
+    for (int k = 0; k < count && x + k < screen->cols; k++)
     {
-        int car_nr = hostile_positions[i]; // y tego aktualnego wrogiego
-        if ((frog->y == cars[car_nr].y && frog->x == cars[car_nr].x) ||
-            (frog->y == cars[car_nr].y && frog->x == cars[car_nr].x + 2) ||
-            (frog->y + 1 == cars[car_nr].y && frog->x == cars[car_nr].x) ||   //warunki czy to kolizja
-            (frog->y + 1 == cars[car_nr].y && frog->x == cars[car_nr].x + 2))
+        if (x + k >= 0)
         {
-            return true;
+            screen->cells[y * screen->cols + x + k] = ansi_chtype(cells[k]);
         }
     }
-    return false;
 }
 
-//Moves frog by friendly cars
-void move_frog_by_car(Frog *frog, Car *cars, GameConfig config, int *friendly_positions, Obstacle *obstacles, PushingCar *push_car)
+//printf-style text in the given attributes, through the same backend as put_cells
+void put_text(WINDOW *win, Renderer *renderer, int y, int x, chtype attributes, const char *format, ...)
 {
-    int tmp = FriendlyPushDistance; // jak daleko zaba moze byc popchnieta
-
-    for (int i = 0; i < config.number_of_friendly_cars; i++)
+    va_list args;
+    va_start(args, format);
+    if (renderer->ansi == nullptr)
     {
-        int car_nr = friendly_positions[i]; // indeks samochodu ktory moze poruszyc zabe
-        if ((frog->y == cars[car_nr].y && frog->x == cars[car_nr].x) ||
-            (frog->y == cars[car_nr].y && frog->x == cars[car_nr].x + 2) || // warunki zeby zaba moga zostac poruszona przez samochod
-            (frog->y + 1 == cars[car_nr].y && frog->x == cars[car_nr].x) ||
-            (frog->y + 1 == cars[car_nr].y && frog->x == cars[car_nr].x + 2))
-        {
-
-            // Determine the direction of the car
-            int push_direction = cars[car_nr].direction;
-
-            for (int j = 0; j < ObstacleNumber; j++)
-            {
-                if (frog->y == obstacles[j].y && frog->x == obstacles[j].x - tmp ||
-                    frog->y + 1== obstacles[j].y && frog->x == obstacles[j].x - tmp ||
-                    frog->y == obstacles[j].y && frog->x == obstacles[j].x + tmp || //sprawdzamy czy w okol zaby nie ma zadnej przeszkody w odleglosci tmp
-                    frog->y + 1== obstacles[j].y && frog->x == obstacles[j].x + tmp)
-                {
-                    if (push_direction == 1) // jesli tak to poruszamy ja inaczej zeby uniknac przeszkody
-                    {
-                        frog->x += tmp - 1;
-                        continue;
-                    }
-                    if (push_direction == -1)
-                    {
-                        frog->x -= tmp + 1;
-                    }
-                }
-            }
-
-            //Move frog in the direction the car is moving
-            if (push_direction == 1)
-            { //Moving right
-                if (frog->x + tmp < config.playing_area_width - 1) // sprawdzamy czy nie wychodzi poza plancze
-                {
-                    frog->x += tmp;
-                }
-                else
-                {
-                    frog->x = config.playing_area_width - 2;
-                }
-            }
-            else if (push_direction == -1)
-            { //Moving left
-                if (frog->x - tmp > 1) // tez sprawdzamy czy nie wychodzi poza plansze
-                {
-                    frog->x -= tmp;
-                }
-                else
-                {
-                    frog->x = 1;
-                }
-            }
-        }
+        wattron(win, attributes);
+        wmove(win, y, x);
+        vw_printw(win, format, args);
+        wattroff(win, attributes);
+    }
+    else
+    {
+        char text[AnsiTextLength];
+        vsnprintf(text, sizeof(text), format, args);
+        ansi_text(renderer->ansi, getbegy(win) + y, getbegx(win) + x, PAIR_NUMBER(attributes), text); // bez pogrubienia, tylko kolor
     }
+    va_end(args);
 }
 
-//Check collision between frog and friendly cars
-void check_collision_friendly_car(Frog *frog, Car *cars, GameConfig config, int *friendly_positions, Obstacle *obstacles, PushingCar *push_car)
+//Send the frame: doupdate for ncurses, one write() of the encoded difference for ANSI
+void present_frame(WINDOW *board_win, Renderer *renderer)
 {
-    for (int i = 0; i < config.number_of_friendly_cars; i++) // wszystkie friendly samochody
+    AnsiScreen *screen = renderer->ansi;
+    if (screen == nullptr)
     {
-        int car_nr = friendly_positions[i]; // y tego aktualnego
+        wnoutrefresh(board_win); // zmiany w board_win
+        doupdate(); // jedno wyslanie zmian do terminala
+        return;
+    }
 
-        if ((frog->y == cars[car_nr].y && frog->x == cars[car_nr].x) ||
-            (frog->y == cars[car_nr].y && frog->x == cars[car_nr].x + 2) ||
-            (frog->y + 1 == cars[car_nr].y && frog->x == cars[car_nr].x) ||     // warunki do sprawdzenia czy zaba jest w kolizji z samochodem
-            (frog->y + 1 == cars[car_nr].y && frog->x == cars[car_nr].x + 2))
+    ansi_flush_frame(screen);
+    size_t sent = 0;
+    while (sent < screen->out_used)
+    {
+        ssize_t size = write(screen->fd, screen->out + sent, screen->out_used - sent);
+        if (size < 0 && errno != EINTR)
         {
-            push_car->waiting_to_push = 1; // jesli tak to ustawiamy 1 - czyli ze tak
-            push_car->car_index = car_nr; // podajemy y tego samochodu
-
-            return;
+            break; // terminal zniknal, klatka przepada
         }
+        sent += size > 0 ? (size_t)size : 0;
     }
-    //Reset if no collision
-    push_car->waiting_to_push;
-    push_car->car_index = -1;
+    screen->out_used = 0;
 }
 
 
+//BOARD FUNCTIONS
 
-//FROG FUNCTIONS
-
-//Create frog at starting position
-void create_frog(Frog *frog, int BoardHeight, int BoardWidth)
-{ // Wspolrzedne dla wyrysowania zaby
-    frog->x = BoardWidth / 2;
-    frog->y = BoardHeight - 3;
-}
-
-//Check if frog can jump based on delay
-bool frog_jump_delay()
+//Create game board window
+WINDOW *create_board(int BoardHeight, int BoardWidth)
 {
-    static struct timeval last_jump_time = {0, 0}; // przechowywanie czasu ostatniego skoku statynie by nie mogla byc zmieniona
-    struct timeval current_time;
-    gettimeofday(&current_time, NULL); //pobranie czasu systemowego i zapisanie go w current_time
+    int xMax, yMax; // zmienne do przechowywania terminala
+    getmaxyx(stdscr, yMax, xMax); // pobierania wysokosci i szerokosci terminala
 
-    double elapsed_time = (current_time.tv_sec - last_jump_time.tv_sec) + // obliczenie czasu od ostatniego skoku
-                          (current_time.tv_usec - last_jump_time.tv_usec) / 1000000.0;
+    refresh();
+    // tworzenie okna z wymiarami BoardHeight x BoardWidth, umieszczenia okna w srodku terminala, obliczenie wspolrzednych jego srodka
+    WINDOW *board_win = newwin(BoardHeight, BoardWidth, (yMax / 2) - (BoardHeight / 2), (xMax / 2) - (BoardWidth / 2));
 
-    if (elapsed_time >= JumpDelay) // jesli czas ktory uplynal jest wiekszy od opoznienia to mozemy ruszyc zaba
+    if (!board_win) // czy udalo sie utworzyc okno
     {
-        last_jump_time = current_time; // na nowo nadajemy czas ostatniemu skokowi
-        return true;
+        printw("Error: Could not create board window\n");
+        refresh();
+        return nullptr;
     }
-    return false;
+
+    box(board_win, 0, 0); // rysowanie ramki board_win dla domyslnych znakow
+    wrefresh(board_win); // odswiezanie okna by wyswietlic ramke
+    return board_win;
 }
 
-//Move frog based on input direction
-void frog_move(Frog *frog, int dir, GameConfig config, Obstacle *obstacle)
+//Put one cell into the static layer
+void set_static_cell(Renderer *renderer, int y, int x, chtype cell)
 {
-    if (!frog_jump_delay()) // sprawdzanie czy uplynelo juz wystarczajaco czasu na ruch
+    if (y >= 0 && y < renderer->rows && x >= 0 && x < renderer->cols)
     {
-        return;
+        renderer->static_cells[y * renderer->cols + x] = cell;
     }
+}
 
-    int new_x = frog->x;
-    int new_y = frog->y;
+//Build board borders into the static layer
+void build_board(Renderer *renderer)
+{
+    int rows = renderer->rows, cols = renderer->cols;
 
-    if (dir == KEY_UP)
+    for (int i = 0; i < rows * cols; i++)
     {
-        if (frog->y > 1)
-        {
-            frog->y--;
-        }
+        renderer->static_cells[i] = ' '; // puste pole jak po werase
     }
-    if (dir == KEY_DOWN)
+    for (int x = 1; x < cols - 1; x++) // ramka jak w box(board_win, 0, 0)
     {
-        if (frog->y < config.playing_area_height - 3)
-        {
-            frog->y++;
-        }
+        set_static_cell(renderer, 0, x, ACS_HLINE);
+        set_static_cell(renderer, rows - 1, x, ACS_HLINE);
     }
-    if (dir == KEY_LEFT)
+    for (int y = 1; y < rows - 1; y++)
     {
-        if (frog->x > 1)
-        {
-            frog->x--;
-        }
+        set_static_cell(renderer, y, 0, ACS_VLINE);
+        set_static_cell(renderer, y, cols - 1, ACS_VLINE);
     }
-    if (dir == KEY_RIGHT)
+    set_static_cell(renderer, 0, 0, ACS_ULCORNER);
+    set_static_cell(renderer, 0, cols - 1, ACS_URCORNER);
+    set_static_cell(renderer, rows - 1, 0, ACS_LLCORNER);
+    set_static_cell(renderer, rows - 1, cols - 1, ACS_LRCORNER);
+}
+
+//Display game information
+void display_info(WINDOW *board_win, Renderer *renderer, int elapsed_time, int distance, GameConfig config)
+{
+    int x, y;
+    getbegyx(board_win, y, x);
+    int width = getmaxx(board_win);
+
+    int start_x = x + width + 5;
+
+    if (start_x + 20 > COLS)
     {
-        if (frog->x < config.playing_area_width - 2)
-        {
-            frog->x++;
-        }
+        put_text(stdscr, renderer, TextHeight, start_x, 0, "Info Area Overflow");
+        return;
     }
 
-    if (check_collision_obstacle(frog, obstacle, ObstacleNumber))
+    put_text(stdscr, renderer, TextHeight, start_x, COLOR_PAIR(7), "Name: %s", "Karol");
+    put_text(stdscr, renderer, TextHeight + 1, start_x, COLOR_PAIR(7), "Surname: %s", "Obrycki");
+    put_text(stdscr, renderer, TextHeight + 2, start_x, COLOR_PAIR(7), "Index: %d", 203264);
+    put_text(stdscr, renderer, TextHeight + 3, start_x, COLOR_PAIR(7), "Time: %d seconds", elapsed_time);
+    if (distance >= 0) // tylko w trybie endless
     {
-        frog->x = new_x;
-        frog->y = new_y;
+        put_text(stdscr, renderer, TextHeight + 4, start_x, COLOR_PAIR(7), "Distance: %d rows", distance);
     }
 }
 
-//Draw frog on the board
-void draw_frog(WINDOW *board_win, Frog *frog)
-{
-    wattron(board_win, COLOR_PAIR(1)); // wlacz kolor dla board_win
-    mvwprintw(board_win, frog->y, frog->x, "O"); //rysujemy zabe
-    mvwprintw(board_win, frog->y + 1, frog->x, "O");
-    wattroff(board_win, COLOR_PAIR(1)); //wylacz kolor dla board_win
-}
+//Display "FROGGER" text
+void frogger_text(WINDOW *board_win, Renderer *renderer)
+{//wypisanie napisu FROGGER na samym srodku na gorze
+    int xMax, yMax;
+    getbegyx(board_win, yMax, xMax);
+    int width = getmaxx(board_win);
 
-//Delete previous frog from the board after move
-void delete_frog(WINDOW *board_win, Frog *frog)
-{
-    wattron(board_win, COLOR_PAIR(3));
-    mvwprintw(board_win, frog->y, frog->x, " ");
-    mvwprintw(board_win, frog->y + 1, frog->x, " ");
-    wattroff(board_win, COLOR_PAIR(3));
+    put_text(stdscr, renderer, yMax - 2, xMax + (width - strlen("FROGGER")) / 2 + 1, COLOR_PAIR(8), "FROGGER");
 }
 
 
+//ENDING FUNCTIONS
 
-//Gameplay functions
-
-bool process_user_input(WINDOW *board_win, Frog *frog, Car *car, GameConfig config, int *friendly_positions, Obstacle *obstacle, PushingCar *push_car)
-{
-    int move_input = wgetch(board_win); //przetrzymuje znak wprowadzony przez uzytkownika w oknie board_win
-
-    //End game
-    if (move_input == 'o')
-    {
-        return true;
-    }
+//Initialize finish area
+void creare_finish(Renderer *renderer, Finish *finish, GameConfig config)
+{   //wspolrzedne dla konca gry
+    finish->x = config.playing_area_width / 2;
+    finish->y = 1;
 
-    //Check if friendly car should wait for input
-    if (push_car->waiting_to_push) // friendly samochod czeka na klikniecie 'e' by moc sie przesunac
-    {
-        if (move_input == 'e')
-        {
-            move_frog_by_car(frog, car, config, friendly_positions, obstacle, push_car);
+    //wyrysuj koniec gry do warstwy statycznej
+    set_static_cell(renderer, finish->y, finish->x, ' ' | COLOR_PAIR(1));
+}
 
-            push_car->waiting_to_push = 0; // aktualizujemy samochod ze juz ruszony
-            push_car->car_index = -1; // cofamy indeks samochodu na zaden
+//Check if frog has reached the finish
+bool check_finish_collision(Frog *frog, Finish *finish)
+{
+    return (frog->x == finish->x && frog->y == finish->y);
+}
 
-        }
-    }
+void display_win_message(WINDOW *board_win, Renderer *renderer, int elapsed_time, GameConfig config)
+{
+    int rows, cols;
+    getmaxyx(board_win, rows, cols);
 
-    if (move_input != ERR) // o ile wejscie nie bylo bledne mozemy ruszyc zabe
-    {
-        frog_move(frog, move_input, config, obstacle);
-    }
+    const char *message = "You Won!";
+    int x = (cols - strlen(message)) / 2;
+    int y = rows / 2;
 
-    return false;
+    put_text(board_win, renderer, y, x, A_BOLD, "%s", message);
+    put_text(board_win, renderer, y + 1, x - 5, A_BOLD, "You've got %d points", config.playing_area_width / elapsed_time * 3);
+    present_frame(board_win, renderer);
+    usleep(2000000);
 }
 
-bool refresh_screen(WINDOW *board_win, int *used_flags, Frog *frog, Car *car, GameConfig config,
-                    int *hostile_positions, int *friendly_positions, int *stopping_positions,
-                    Obstacle *obstacle, Finish *finish, PushingCar *push_car, time_t start_time,
-                    struct timeval &last_refresh, struct timeval &current_time)
+void display_lose_message(WINDOW *board_win, Renderer *renderer)
 {
-    long elapsed_refresh = (current_time.tv_sec - last_refresh.tv_sec) * 1000000L + // sprawdzanie czasu od osatatniego odswierzenia ekranu
-                               (current_time.tv_usec - last_refresh.tv_usec);
-    if (elapsed_refresh >= RefreshDelay) // jesli czas od ostateniego refresha wiekszy od limitu na refresh mozemy dzialac
-    {
-        //All the board elements
-        werase(board_win);
-        draw_board(board_win);
-        frogger_text(board_win);
-        draw_roads(used_flags, board_win, config.playing_area_height, config.playing_area_width);
-        creare_finish(board_win, finish, config);
-        draw_cars(board_win, car, config, hostile_positions, friendly_positions, stopping_positions);
-        draw_obstacles(board_win, obstacle, ObstacleNumber);
-        draw_frog(board_win, frog);
+    int rows, cols;
+    getmaxyx(board_win, rows, cols);
+
+    const char *message = "You Lose!";
+    int x = (cols - strlen(message)) / 2 + 1;
+    int y = rows / 2;
+
+    put_text(board_win, renderer, y, x, A_BOLD, "%s", message);
+    present_frame(board_win, renderer);
+    usleep(2000000);
+}
+
+
+
+//OCCUPANCY FUNCTIONS
+
+void occupancy_init(Occupancy *occupancy, Arena *arena, int rows, int cols)
+{
+    occupancy->rows = rows;
+    occupancy->words = (cols + 63) / 64;
+    occupancy->top = 0;
+    occupancy->base = 0;
+    size_t layer = (size_t)rows * occupancy->words; // rozmiar jednej warstwy w slowach
+
+    uint64_t *bits = (uint64_t *)arena_alloc(arena, layer * 4 * sizeof(uint64_t)); // wszystkie warstwy w jednym bloku
+    occupancy->obstacle = bits;
+    occupancy->hostile = bits + layer;
+    occupancy->friendly = bits + layer * 2;
+    occupancy->stopping = bits + layer * 3;
+}
+
+//Ring slot of world row y, -1 when the row is out of view (with top == base == 0 the slot is y itself)
+int occupancy_slot(Occupancy *occupancy, int y)
+{
+    int row = y - occupancy->top;
+    if (row < 0 || row >= occupancy->rows)
+    {
+        return -1;
+    }
+    int slot = occupancy->base + row;
+    return slot >= occupancy->rows ? slot - occupancy->rows : slot;
+}
+
+void occupancy_set(Occupancy *occupancy, uint64_t *layer, int y, int x, bool value)
+{
+    int slot = occupancy_slot(occupancy, y);
+    if (slot < 0 || x < 0 || x >= occupancy->words * 64)
+    {
+        return;
+    }
+    uint64_t *word = &layer[(size_t)slot * occupancy->words + x / 64];
+    uint64_t bit = 1ULL << (x % 64);
+    *word = value ? (*word | bit) : (*word & ~bit);
+}
+
+bool occupancy_test(Occupancy *occupancy, uint64_t *layer, int y, int x)
+{
+    int slot = occupancy_slot(occupancy, y);
+    if (slot < 0 || x < 0 || x >= occupancy->words * 64)
+    {
+        return false;
+    }
+    return (layer[(size_t)slot * occupancy->words + x / 64] >> (x % 64)) & 1;
+}
+
+//Frog takes two cells: (x, y) and (x, y + 1)
+bool occupancy_test_frog(Occupancy *occupancy, uint64_t *layer, Frog *frog)
+{
+    return occupancy_test(occupancy, layer, frog->y, frog->x) || occupancy_test(occupancy, layer, frog->y + 1, frog->x);
+}
+
+//Mark cells of a car the frog collides with: both wheels 'o' at x and x + 2
+void occupancy_mark_car(Occupancy *occupancy, uint64_t *layer, int y, int x, bool value)
+{
+    occupancy_set(occupancy, layer, y, x, value);
+    occupancy_set(occupancy, layer, y, x + 2, value);
+}
+
+
+//ROAD FUNCTIONS
+
+//Initialize road flags
+void initialize_flags(int *flags, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        flags[i] = 0;
+    }
+}
+
+//Check roads collision
+bool is_roads_collision(int *flags, int road_y, int road_height, int rows)
+{
+    if (road_y < 0 || road_y >= rows) // sprawdzanie czy droga jest w obszarze planszy
+    {
+        return true;
+    }
+    return flags[road_y] != 0; // sprawdzanie czy droga jest juz zajeta (!= 0 == true, my chcemy false)
+}
+
+//Mark a road for checking the collision
+void mark_road(int *flags, int road_y, int road_height, int rows)
+{
+    if (road_y >= 0 && road_y < rows) // czy droga w obszarze planszy
+    {
+        flags[road_y] = 1; // oznaczamy nowa droge
+    }
+}
 
-        int elapsed_time = (int)(time(NULL) - start_time); // oblicza czas gry w sekundach jako roznice pomiedzy aktualnym stanem a rozpoczeciem gry
-        display_info(board_win, elapsed_time, config); // wyswietlenie tej informacji
+void build_one_road(Renderer *renderer, int road_y)
+{
+    for (int x = 0; x < renderer->cols - 2; x++) // droga w kolorze 2 bez ramki
+    {
+        set_static_cell(renderer, road_y, x + 1, ' ' | COLOR_PAIR(2));
+    }
+}
 
-        if (check_collision_hostile_car(frog, car, config, hostile_positions))
+//Build all roads into the static layer
+void build_roads(int *used_flags, Renderer *renderer)
+{   //budowanie drogi dla wspolrzednych y z tablicy
+    for (int y = 0; y < renderer->rows; y++)
+    {
+        if (used_flags[y] == 1)
         {
-            delete_frog(board_win, frog); //usuwaj zabe
-            wrefresh(board_win); //odswierz zmiany
-            display_lose_message(board_win); // wyswietl komunikat o przegranej
-            return true;
+            build_one_road(renderer, y);
         }
+    }
+}
+
+//Pick number_of_roads distinct rows from 2 to rows - 4 with Floyd's sampling: one draw per road, no retries
+void get_random_road(Rng *rng, int *used_flags, int rows, int number_of_roads)
+{
+    int first = 2, candidates = rows - RoadHeight - 3 - first + 1; // Generowanie drog od 2 do rows - 4
 
-        //Check collisions with friendly cars
-        check_collision_friendly_car(frog, car, config, friendly_positions, obstacle, push_car);
+    for (int j = candidates - number_of_roads; j < candidates; j++)
+    {
+        int road_y = first + get_random_number(rng, 0, j);
 
-        if (check_finish_collision(frog, finish)) // czy zaba doszla do mety
+        if (is_roads_collision(used_flags, road_y, RoadHeight, rows))
         {
-            display_win_message(board_win, elapsed_time, config); // wyswietl win info
-            return true;
+            road_y = first + j; // wiersz juz zajety, j na pewno jest jeszcze wolne
         }
 
-        wrefresh(board_win); // odswierz zmiany w board_win
-        refresh(); // odsierza caly terminal
-        last_refresh = current_time; // pobiera czas najnowszego odswierzenia
+        mark_road(used_flags, road_y, RoadHeight, rows);
     }
-    return false;
 }
 
-void initialize_game_elements(Frog *frog, Car *car, Obstacle *obstacle, int *used_flags, GameConfig *config)
+//Move count random elements of values to its front (partial Fisher-Yates shuffle)
+void shuffle_front(Rng *rng, int *values, int size, int count)
 {
-    initialize_flags(used_flags, config->playing_area_height);
-    get_random_road(used_flags, config->playing_area_height);
-    initialize_cars(car, used_flags, config->playing_area_height, config->playing_area_width);
-    initialize_obstacle(obstacle, used_flags, config->playing_area_height, config->playing_area_width);
-    create_frog(frog, config->playing_area_height, config->playing_area_width);
+    for (int i = 0; i < count && i < size; i++)
+    {
+        int j = get_random_number(rng, i, size - 1);
+        int tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+    }
 }
 
-WINDOW *initialize_ncurses(GameConfig config)
+
+//OBSTACLE FUNCTIONS
+
+void initialize_obstacle(Rng *rng, Obstacle *obstacles, int number_of_obstacles, const int *used_flags, int rows, int cols, int *shuffle)
 {
-    initscr(); //wlacza biblioteke ncurses
-    curs_set(FALSE); //ukrycie kursora
-    noecho(); //ukrycie wprowadzanych danych
-    initialize_colors(); //ustawienie kolorow
+    int free_rows = 0; // wiersze od 3 do rows - 5 bez drogi
+    for (int k = 3; k <= rows - 5; k++)
+    {
+        if (used_flags[k] == 0)
+        {
+            shuffle[free_rows++] = k;
+        }
+    }
 
-    //Create board
-    WINDOW *board_win = create_board(config.playing_area_height, config.playing_area_width);
-    if (board_win == nullptr) // jak sie nie uda to konczymy ncurses
+    //Every obstacle gets its own row, validate_config guarantees there are enough of them
+    shuffle_front(rng, shuffle, free_rows, number_of_obstacles);
+    for (int i = 0; i < number_of_obstacles && i < free_rows; i++)
     {
-        endwin();
+        obstacles[i].y = shuffle[i]; //y dla przeszkody
+        obstacles[i].x = get_random_number(rng, 1, cols - 6); // losowanie x dla przeszkody
     }
-    keypad(board_win, TRUE); // wlacza obsluge klawiatury w oknie boardwin
-    keypad(stdscr, TRUE); // wlacza obsluge klawiatury w glownym oknie
+}
 
-    return board_win; // zwraca wskaznik okna do wyswietlenia
+void build_obstacles(Renderer *renderer, Obstacle *obstacles, int obstacle_count)
+{
+    for (int i = 0; i < obstacle_count; i++)
+    {
+        set_static_cell(renderer, obstacles[i].y, obstacles[i].x, '#' | COLOR_PAIR(6)); // przeszkoda w warstwie statycznej
+    }
+}
+
+//Check collision with the frog and obstacles
+bool check_collision_obstacle(Frog *frog, Occupancy *occupancy)
+{ // sprawdzenie czy zaba nie bedzie wchodzi na przeszkode
+    return occupancy_test_frog(occupancy, occupancy->obstacle, frog);
+}
+
+
+//CARS FUNCTIONS
+
+void car_store_init(CarStore *cars, Arena *arena, GameConfig config)
+{
+    int count = config.number_of_hostile_cars + config.number_of_friendly_cars + config.number_of_stopping_cars;
+    int *block = (int *)arena_alloc(arena, sizeof(int) * count * 10); // wszystkie tablice w jednym bloku
+
+    cars->count = count;
+    cars->begin[CarHostile] = 0;
+    cars->begin[CarFriendly] = config.number_of_hostile_cars;
+    cars->begin[CarStopping] = cars->begin[CarFriendly] + config.number_of_friendly_cars;
+    cars->begin[CarKinds] = count;
+    cars->x = block;
+    cars->y = block + count;
+    cars->direction = block + count * 2;
+    cars->speed = block + count * 3;
+    cars->is_static = block + count * 4;
+    cars->old_x = block + count * 5;
+    cars->edge = block + count * 6;
+    cars->roll = block + count * 7;
+    cars->new_speed = block + count * 8;
+    cars->coin = block + count * 9;
 }
 
-void draw_initial_state(WINDOW *board_win, Frog *frog, Car *car, Obstacle *obstacle, int *used_flags,
-                        GameConfig *config, int *hostile_positions, int *friendly_positions,
-                        int *stopping_positions, Finish *finish)
+//Which kind of car is stored at index i
+CarKind car_kind(CarStore *cars, int i)
 {
-    wclear(board_win); // zamyka wszystko co bylo dotychczas w oknie
+    if (i < cars->begin[CarFriendly])
+    {
+        return CarHostile;
+    }
+    return i < cars->begin[CarStopping] ? CarFriendly : CarStopping;
+}
+
+//Check if the frog stands on any cell of the car
+bool frog_on_car(Frog *frog, CarStore *cars, int i)
+{
+    return (frog->y == cars->y[i] || frog->y + 1 == cars->y[i]) && frog->x >= cars->x[i] && frog->x <= cars->x[i] + 2;
+}
 
-    draw_board(board_win);
-    creare_finish(board_win, finish, *config);
-    draw_roads(used_flags, board_win, config->playing_area_height, config->playing_area_width);
-    draw_cars(board_win, car, *config, hostile_positions, friendly_positions, stopping_positions);
-    draw_obstacles(board_win, obstacle, ObstacleNumber);
-    draw_frog(board_win, frog);
+//Give every car its own road: hostile, friendly and stopping cars take the front of one shuffle in turn
+void initialize_car_colors(Rng *rng, GameConfig config, int *positions, int *shuffle)
+{
+    int road_number = config.number_of_roads;
+    int cars = config.number_of_hostile_cars + config.number_of_friendly_cars + config.number_of_stopping_cars;
 
-    wrefresh(board_win); //odswierzenie okna board_win wraz z jego wszystkimi zmianami
+    for (int k = 0; k < road_number; k++)
+    {
+        shuffle[k] = k;
+    }
+    shuffle_front(rng, shuffle, road_number, cars);
+    memcpy(positions, shuffle, sizeof(int) * cars); // numery drog, grupami jak w CarStore
 }
 
-void gameplay(int *used_flags, Frog *frog, GameConfig config, WINDOW *board_win, Car *car,
-              int *hostile_positions, int *friendly_positions, int *stopping_positions, Obstacle *obstacle, PushingCar *push_car)
+//Rows of the roads from the top of the board
+void collect_roads(const int *used_flags, GameConfig config, int *roads)
 {
-     nodelay(board_win, TRUE); // ustawiamy okno tak ze nie czeka na wejscie uzytkownika
-     int game_ticks = 0; // zmienna do zliczania liczby klatek gry, jest ona potrzebna do poruszania samochodami
+    int road_count = 0;
+    for (int y = 0; y < config.playing_area_height && road_count < config.number_of_roads; y++)
+    {
+        if (used_flags[y] == 1)
+        {
+            roads[road_count++] = y; // y kolejnych drog
+        }
+    }
+}
 
-     struct timeval last_car_move, last_refresh, current_time; // struktury do pomiaru czasu, gdzie ktore zdarzenia mialy miejsce
+//Put one car of every kind on the roads chosen by initialize_car_colors
+void initialize_cars(Rng *rng, CarStore *cars, const int *used_flags, GameConfig config, int *roads, int *positions, int *shuffle)
+{
+    collect_roads(used_flags, config, roads);
 
-     gettimeofday(&last_car_move, NULL); // pobieranie bierzacego czasu dla ostatniego ruchu samochodow
-     gettimeofday(&last_refresh, NULL); // pobieranie bierzacego czasu dla ostatniego odswiezania ekranu
-     time_t start_time = time(NULL); // czas rozpoczecia gry w sekundach
+    //Numery drog dla kolejnych samochodow, grupami
+    initialize_car_colors(rng, config, positions, shuffle);
 
-     Finish finish;
+    for (int i = 0; i < cars->count; i++)
+    {
+        cars->y[i] = roads[positions[i]]; // wiersz y dla samochodu
+        cars->x[i] = get_random_number(rng, 4, config.playing_area_width - 6); // losowanie x dla samochodu pomiedzy 4 a cols - 6
+        cars->direction[i] = (get_random_number(rng, 0, 1) == 0) ? 1 : -1; // losujemy kierunek dla samochodu (1 - prawo, -1 - lewo)
+        cars->speed[i] = get_random_number(rng, 1, 3); // losowanie predkosci samochodu
+        cars->is_static[i] = false;
+    }
+}
 
-     while (true)
-     {
-         gettimeofday(&current_time, NULL); // pobieranie bierzacego czasu w mikrosekundach w celu policzenia opoznienia
+//Deal the cars out to the roads and space every lane evenly: x ascending, at least LaneGap apart, also across the wrap
+void initialize_lanes(Rng *rng, CarStore *cars, Lanes *lanes, const int *used_flags, GameConfig config, int *roads, int *shuffle)
+{
+    int road_count = config.number_of_roads;
+    int ring = config.playing_area_width - 4; // pozycje x od 1 do width - 4, za ostatnia jest pierwsza
+    collect_roads(used_flags, config, roads);
 
-         if (process_user_input(board_win, frog, car, config, friendly_positions, obstacle, push_car)) // sprawdza czy jakakolwiek akcja zostala wprowadzona od uzytkownika i czy zakonczyl gre
-         {
-             break;
-         }
-        // ile minelo mikrosekund od ostatniego ruchu samochodow
-         long elapsed_car_move = (current_time.tv_sec - last_car_move.tv_sec) * 1000000L +
-                        (current_time.tv_usec - last_car_move.tv_usec);
-         if (elapsed_car_move >= FrameDelay) // sprawdzamy czy minal odpowiedni czas od ostatniego ruchu samochodem, jesli tak wykonujemy ruch samochodow
-         {
-             move_cars(car, config, hostile_positions, friendly_positions, stopping_positions, game_ticks, frog, push_car);
-             game_ticks++; // zwiekszamy licznik klatek gry
-             last_car_move = current_time; // aktualizujemy czas ostatniego ruchu samochodem
-         }
+    for (int i = 0; i < cars->count; i++)
+    {
+        shuffle[i] = i;
+    }
+    shuffle_front(rng, shuffle, cars->count, cars->count); // rodzaje samochodow wymieszane miedzy pasami
 
-         if (refresh_screen(board_win, used_flags, frog, car, config, hostile_positions, friendly_positions, stopping_positions,
-                           obstacle, &finish, push_car, start_time, last_refresh, current_time)) // odswierzenie ekranu, wyrysowanie wszystkich zaktualizowanych elementow, sprawdzenie czy gra powinna zostac zakonczona
-         {
-             break; // jesli gra zakonczona, wychodzimy z petli
-         }
-     }
+    for (int y = 0; y < lanes->rows; y++)
+    {
+        lanes->row_lane[y] = -1;
+    }
+    lanes->count = road_count;
+    lanes->begin[0] = 0;
+    for (int k = 0; k < road_count; k++)
+    {
+        int count = cars->count / road_count + (k < cars->count % road_count); // samochod shuffle[j] jedzie pasem j % road_count
+        int spacing = ring / (count > 0 ? count : 1); // co najmniej LaneGap, sprawdza validate_config
+        lanes->begin[k + 1] = lanes->begin[k] + count;
+        lanes->y[k] = roads[k];
+        lanes->direction[k] = (get_random_number(rng, 0, 1) == 0) ? 1 : -1;
+        lanes->row_lane[roads[k]] = k;
+
+        for (int j = 0; j < count; j++)
+        {
+            int i = shuffle[k + j * road_count];
+            lanes->cars[lanes->begin[k] + j] = i;
+            cars->y[i] = roads[k];
+            cars->x[i] = 1 + j * spacing + get_random_number(rng, 0, spacing - LaneGap); // kazdy w swoim odcinku pasa
+            cars->direction[i] = lanes->direction[k];
+            cars->speed[i] = get_random_number(rng, 1, 3);
+            cars->is_static[i] = false;
+        }
+    }
 }
 
+//Draw one car in its color
+void draw_car(WINDOW *board_win, Renderer *renderer, int x, int y, int pair)
+{
+    chtype cells[3] = {'o' | (chtype)COLOR_PAIR(pair), '-' | (chtype)COLOR_PAIR(pair), 'o' | (chtype)COLOR_PAIR(pair)};
+    int start = x < 0 ? -x : 0; // przycinanie do szerokosci planszy
+    int end = x + 3 > renderer->cols ? renderer->cols - x : 3;
 
-int main(int argc, char *argv[])
+    if (end > start && y > 0 && y < renderer->rows - 1) // wiersze ramki i spoza widoku zostaja puste
+    {
+        put_cells(board_win, renderer, y, x + start, cells + start, end - start); // caly samochod jednym wywolaniem
+    }
+}
+
+//Remember which color every car is drawn with (Red - hostile, Blue - friendly, Magenta - stopping)
+void initialize_car_pairs(Renderer *renderer, CarStore *cars)
 {
-    GameConfig config; //przechowuje konfigurajce gry
+    for (int i = 0; i < cars->count; i++)
+    {
+        renderer->car_pair[i] = 3 + car_kind(cars, i);
+    }
+}
 
-    //Zaladowanie kofuguracji gry
-    if (load_config("config.txt", &config) != 0)
+//Draw all cars
+void draw_cars(WINDOW *board_win, Renderer *renderer, CarStore *cars)
+{
+    for (int i = 0; i < cars->count; i++)
     {
-        return 1;
+        draw_car(board_win, renderer, cars->x[i], cars->y[i] - renderer->top, renderer->car_pair[i]);
+        renderer->drawn_car_x[i] = cars->x[i];
     }
+}
 
-    //Zadeklarowanie wszystkich potrzebnych zmiennych
-    Frog frog;
-    Car car[RoadNumber];
-    Obstacle obstacle[ObstacleNumber];
-    int used_flags[config.playing_area_height];
-    int hostile_positions[config.number_of_hostile_cars] = {0};
-    int friendly_positions[config.number_of_friendly_cars] = {0};
-    int stopping_positions[config.number_of_stopping_cars] = {0};
-    PushingCar push_car = {0, -1};
-    Finish finish;
+//Move the occupancy bits of cars that changed x in this tick
+void update_car_occupancy(CarStore *cars, int begin, int end, Occupancy *occupancy, uint64_t *layer)
+{
+    for (int i = begin; i < end; i++)
+    {
+        if (cars->old_x[i] != cars->x[i])
+        {
+            occupancy_mark_car(occupancy, layer, cars->y[i], cars->old_x[i], false);
+            occupancy_mark_car(occupancy, layer, cars->y[i], cars->x[i], true);
+        }
+    }
+}
+
+//Turn edge flags of cars from begin to end into a list at the front of edge[], returns its length
+int collect_edge_cars(CarStore *cars, int begin, int end)
+{
+    int count = 0;
+    for (int i = begin; i < end; i++)
+    {
+        if (cars->edge[i])
+        {
+            cars->edge[begin + count++] = i; // zapis nigdy nie wyprzedza odczytu
+        }
+    }
+    return count;
+}
 
-    initialize_game_elements(&frog, car, obstacle, used_flags, &config);
+//Move all cars
+void move_hostile_cars(CarStore *cars, GameConfig config, int game_ticks, Occupancy *occupancy, Rng *rng)
+{
+    int cols = config.playing_area_width; // szerokosc planszy
+    int begin = cars->begin[CarHostile], end = cars->begin[CarHostile + 1];
+    int even = game_ticks % 2 == 0, third = game_ticks % 3 == 0; // ktore predkosci ruszaja sie w tej klatce
+    int *__restrict x = cars->x, *__restrict direction = cars->direction, *__restrict speed = cars->speed;
+    int *__restrict old_x = cars->old_x, *__restrict edge = cars->edge;
 
-    WINDOW *board_win = initialize_ncurses(config);
-    if (board_win == nullptr) // jesli zwrocilo nullptr to konczymy
+    for (int i = begin; i < end; i++) // bez rozgalezien, zeby kompilator mogl zwektoryzowac petle
     {
-        return 1;
+        int s = speed[i], xi = x[i];
+        int moving = (s == 1) | ((s == 2) & even) | ((s == 3) & third); // poruszanie sie co odpowiedni czas w zaleznosci od swojej predkosci
+        int at_edge = moving & ((xi <= 1) | (xi >= cols - 4)); // sprawdzamy krawedzie planszy
+        int d = direction[i] * (1 - 2 * at_edge); // jak dotarl do krawedzi zmienia kierunek
+        old_x[i] = xi;
+        direction[i] = d;
+        x[i] = xi + moving * d; // poruszamy samochod
+        edge[i] = at_edge;
+    }
+
+    //Rare edge events draw their random numbers in one batch
+    int edge_count = collect_edge_cars(cars, begin, end);
+    fill_random(rng, cars->roll, edge_count, 1, 4);
+    fill_random(rng, cars->new_speed, edge_count, 1, 3);
+    for (int k = 0; k < edge_count; k++)
+    {
+        int i = edge[begin + k];
+        if (cars->roll[k] == 1) // 25% szans ze zmieni predkosc
+        {
+            speed[i] = cars->new_speed[k]; // losuje nowa predkosc
+        }
+    }
+
+    update_car_occupancy(cars, begin, end, occupancy, occupancy->hostile);
+}
+
+void move_friendly_cars(CarStore *cars, GameConfig config, int game_ticks, Frog *frog, PushingCar *push_car, Occupancy *occupancy, Rng *rng)
+{
+    int cols = config.playing_area_width; // szerokosc planszy
+    int begin = cars->begin[CarFriendly], end = cars->begin[CarFriendly + 1];
+    int even = game_ticks % 2 == 0, third = game_ticks % 3 == 0;
+    int *__restrict x = cars->x, *__restrict direction = cars->direction, *__restrict speed = cars->speed;
+    int *__restrict old_x = cars->old_x, *__restrict edge = cars->edge;
+
+    int waiting = -1; // samochod ktory czeka na przepchniecie zaby nie rusza sie
+    if (push_car->waiting_to_push && push_car->car_index >= begin && push_car->car_index < end)
+    {
+        if (frog_on_car(frog, cars, push_car->car_index)) //sprawdzenie czy zaba jest w odpowiedniej pozycji na przepchniecie
+        {
+            waiting = push_car->car_index;
+        }
+        else
+        {
+            push_car->waiting_to_push = 0; // jesli nie to resetujemy push_car
+            push_car->car_index = -1;
+        }
+    }
+
+    for (int i = begin; i < end; i++)
+    {
+        int s = speed[i], xi = x[i];
+        int moving = ((s == 1) | ((s == 2) & even) | ((s == 3) & third)) & (i != waiting);
+        int nx = xi + moving * direction[i]; // poruszamy samochod
+        old_x[i] = xi;
+        x[i] = nx;
+        edge[i] = moving & ((nx <= 1) | (nx >= cols - 4)); // sprawdzanie granicy planszy
     }
 
-    //Draw initial game state
-    draw_initial_state(board_win, &frog, car, obstacle, used_flags, &config,
-                       hostile_positions, friendly_positions, stopping_positions, &finish);
+    int edge_count = collect_edge_cars(cars, begin, end);
+    fill_random(rng, cars->roll, edge_count, 1, 4);
+    fill_random(rng, cars->new_speed, edge_count, 1, 3);
+    fill_random(rng, cars->coin, edge_count, 1, 2);
+    for (int k = 0; k < edge_count; k++)
+    {
+        int i = edge[begin + k];
+        if (cars->roll[k] == 1) // 25% szans na zmiane predkosci
+        {
+            speed[i] = cars->new_speed[k];
+        }
 
-    //Start gameplay loop
-    gameplay(used_flags, &frog, config, board_win, car, hostile_positions, friendly_positions,
-             stopping_positions, obstacle, &push_car);
+        if (cars->coin[k] == 1) // 50% szans na pojawienie sie z drugiej strony planszy
+        {
+            if (x[i] >= cols - 3) // teleportacja
+            {
+                x[i] = 1;
+            }
+            else if (x[i] < 1) // teleportacja
+            {
+                x[i] = cols - 4;
+            }
+        }
+        else
+        {
+            direction[i] *= -1; // zmiana kierunku
+        }
+    }
 
-    delwin(board_win); // usuwa okno board_win z pamieci
-    endwin(); // konczy dzialanie ncurses
+    update_car_occupancy(cars, begin, end, occupancy, occupancy->friendly);
+}
 
-    return 0;
-}
\ No newline at end of file
+void move_stopping_cars(CarStore *cars, GameConfig config, int game_ticks, Frog *frog, Occupancy *occupancy, Rng *rng)
+{
+    int cols = config.playing_area_width; // szerokosc planszy
+    int begin = cars->begin[CarStopping], end = cars->begin[CarStopping + 1];
+    int even = game_ticks % 2 == 0, third = game_ticks % 3 == 0;
+    int *__restrict x = cars->x, *__restrict y = cars->y, *__restrict direction = cars->direction, *__restrict speed = cars->speed;
+    int *__restrict is_static = cars->is_static, *__restrict old_x = cars->old_x, *__restrict roll = cars->roll, *__restrict new_speed = cars->new_speed;
+    int *__restrict halted = cars->edge; // samochody, ktore stanely w tym ticku (dla dziennika zdarzen)
+    int frog_x = frog->x, frog_y = frog->y;
+
+    fill_random(rng, roll + begin, end - begin, 1, 4); // kazdy jadacy samochod losuje zmiane predkosci
+    fill_random(rng, new_speed + begin, end - begin, 1, 3);
+
+#pragma GCC ivdep // tablice z CarStore nigdy na siebie nie nachodza
+    for (int i = begin; i < end; i++)
+    {
+        int s = speed[i], xi = x[i];
+
+        // Calculate distance to frog
+        int distance1 = abs(xi - frog_x) + abs(y[i] - frog_y); // liczenie odleglosci1
+        int distance2 = abs(xi - frog_x + 2) + abs(y[i] - frog_y); // liczenie odleglosci2
+        int moving_now = (distance1 > StoppingDistance) & (distance2 > StoppingDistance); // jesli distance odpowiednio maly samochod stoi
+        int moving = moving_now & ((s == 1) | ((s == 2) & even) | ((s == 3) & third));
+        int changed = moving & (roll[i] == 1); // 25% szans na zmiane predkosci
+        int nx = xi + moving * direction[i]; // poruszamy samochod
+        int wrap_left = moving_now & (nx >= cols - 3); // teleportacja
+        int wrap_right = moving_now & (nx < 1) & !wrap_left; // teleportacja
+
+        halted[i] = !moving_now & !is_static[i];
+        is_static[i] = !moving_now;
+        old_x[i] = xi;
+        speed[i] = s + changed * (new_speed[i] - s);
+        x[i] = nx + wrap_left * (1 - nx) + wrap_right * (cols - 4 - nx);
+    }
+
+    update_car_occupancy(cars, begin, end, occupancy, occupancy->stopping);
+}
+
+
+//Move cars based on speed and direction
+void move_cars(CarStore *cars, GameConfig config, int game_ticks, Frog *frog, PushingCar *push_car, Occupancy *occupancy, Rng *rng, Rng *hostile_rng)
+{
+    move_hostile_cars(cars, config, game_ticks, occupancy, hostile_rng);
+    move_friendly_cars(cars, config, game_ticks, frog, push_car, occupancy, rng);
+    move_stopping_cars(cars, config, game_ticks, frog, occupancy, rng);
+
+}
+
+//Car with a wheel on cell (x, y), binary search in the lane of that row (-1 - none)
+int lane_car_at(Lanes *lanes, CarStore *cars, int y, int x)
+{
+    int lane = y >= 0 && y < lanes->rows ? lanes->row_lane[y] : -1;
+    if (lane < 0)
+    {
+        return -1;
+    }
+    int low = lanes->begin[lane], high = lanes->begin[lane + 1] - 1, found = -1;
+    while (low <= high) // ostatni samochod z x <= szukanego
+    {
+        int middle = (low + high) / 2;
+        if (cars->x[lanes->cars[middle]] <= x)
+        {
+            found = middle;
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    if (found < 0)
+    {
+        return -1;
+    }
+    int car = lanes->cars[found];
+    return x <= cars->x[car] + 2 ? car : -1;
+}
+
+//Sort every lane by x again, after positions were set from outside (restore of a snapshot)
+void lanes_sort(Lanes *lanes, CarStore *cars)
+{
+    for (int k = 0; k < lanes->count; k++)
+    {
+        int *order = lanes->cars;
+        for (int j = lanes->begin[k] + 1; j < lanes->begin[k + 1]; j++) // prawie posortowane, wstawianie jest liniowe
+        {
+            int car = order[j], m = j;
+            for (; m > lanes->begin[k] && cars->x[order[m - 1]] > cars->x[car]; m--)
+            {
+                order[m] = order[m - 1];
+            }
+            order[m] = car;
+        }
+    }
+}
+
+//Move dense lanes by one tick: a car moves only with more than LaneGap to the car ahead, so nobody overtakes,
+//and the front car wraps around to the back of the lane like a friendly car at the edge
+void move_lanes(Simulation *sim)
+{
+    CarStore *cars = &sim->cars;
+    Lanes *lanes = &sim->lanes;
+    Occupancy *occupancy = &sim->occupancy;
+    uint64_t *layers[CarKinds] = {occupancy->hostile, occupancy->friendly, occupancy->stopping};
+    int cols = sim->config.playing_area_width, ring = cols - 4;
+    int even = sim->game_ticks % 2 == 0, third = sim->game_ticks % 3 == 0;
+    int frog_x = sim->frog.x, frog_y = sim->frog.y;
+    int *__restrict x = cars->x, *__restrict speed = cars->speed, *__restrict step = lanes->step;
+
+    //Friendly car waiting for the push stays, cars behind it queue up
+    int waiting = -1;
+    if (sim->push_car.waiting_to_push && sim->push_car.car_index >= 0)
+    {
+        if (frog_on_car(&sim->frog, cars, sim->push_car.car_index))
+        {
+            waiting = sim->push_car.car_index;
+        }
+        else
+        {
+            sim->push_car.waiting_to_push = 0;
+            sim->push_car.car_index = -1;
+        }
+    }
+
+    for (int k = 0; k < lanes->count; k++)
+    {
+        int begin = lanes->begin[k], end = lanes->begin[k + 1], d = lanes->direction[k];
+        int *order = lanes->cars;
+        int near_row = abs(lanes->y[k] - frog_y) <= StoppingDistance; // tylko blisko zaby samochody stopujace staja
+
+        //Decide from the positions before the tick, so the order of the loop does not matter
+        for (int j = begin; j < end; j++)
+        {
+            int i = order[j];
+            int ahead = d > 0 ? (j + 1 < end ? j + 1 : begin) : (j > begin ? j - 1 : end - 1);
+            int gap = (x[order[ahead]] - x[i]) * d;
+            gap += gap <= 0 ? ring : 0; // samochod przed nami jest za szwem, albo jestesmy sami
+            int s = speed[i];
+            int moving = (s == 1) | ((s == 2) & even) | ((s == 3) & third);
+            if (i >= cars->begin[CarStopping])
+            {
+                int distance1 = abs(x[i] - frog_x) + abs(lanes->y[k] - frog_y);
+                int distance2 = abs(x[i] - frog_x + 2) + abs(lanes->y[k] - frog_y);
+                int stopped = near_row & ((distance1 <= StoppingDistance) | (distance2 <= StoppingDistance));
+                cars->edge[i] = stopped & !cars->is_static[i]; // stanal w tym ticku, dla dziennika zdarzen
+                cars->is_static[i] = stopped;
+                moving &= !stopped;
+            }
+            step[j] = moving & (gap > LaneGap) & (i != waiting);
+        }
+
+        int wrapped = -1;
+        for (int j = begin; j < end; j++)
+        {
+            int i = order[j];
+            cars->old_x[i] = x[i];
+            if (!step[j])
+            {
+                continue;
+            }
+            int nx = x[i] + d;
+            if (nx > cols - 4 || nx < 1) // teleportacja na drugi koniec pasa
+            {
+                nx = nx < 1 ? cols - 4 : 1;
+                wrapped = j;
+                if (get_random_number(&sim->rng, 1, 4) == 1) // 25% szans na zmiane predkosci
+                {
+                    speed[i] = get_random_number(&sim->rng, 1, 3);
+                }
+            }
+            uint64_t *layer = layers[car_kind(cars, i)];
+            occupancy_mark_car(occupancy, layer, lanes->y[k], x[i], false);
+            occupancy_mark_car(occupancy, layer, lanes->y[k], nx, true);
+            x[i] = nx;
+        }
+
+        //Only the front car can wrap, it moves from one end of the sorted lane to the other
+        if (wrapped == end - 1)
+        {
+            int car = order[wrapped];
+            memmove(order + begin + 1, order + begin, sizeof(int) * (end - 1 - begin));
+            order[begin] = car;
+        }
+        else if (wrapped == begin)
+        {
+            int car = order[wrapped];
+            memmove(order + begin, order + begin + 1, sizeof(int) * (end - 1 - begin));
+            order[end - 1] = car;
+        }
+    }
+}
+
+//Check collision between frog and hostile cars
+bool check_collision_hostile_car(Frog *frog, Occupancy *occupancy)
+{
+    return occupancy_test_frog(occupancy, occupancy->hostile, frog); //kolizja gdy ktorekolwiek pole zaby trafia kolo wrogiego samochodu
+}
+
+//Moves frog by friendly cars
+void move_frog_by_car(Frog *frog, CarStore *cars, GameConfig config, Occupancy *occupancy, int *row_car, Lanes *lanes)
+{
+    int tmp = FriendlyPushDistance; // jak daleko zaba moze byc popchnieta
+
+    for (int row = frog->y; row <= frog->y + 1; row++) // oba wiersze zajmowane przez zabe
+    {
+        if (!occupancy_test(occupancy, occupancy->friendly, row, frog->x)) // warunek zeby zaba mogla zostac poruszona przez samochod
+        {
+            continue;
+        }
+
+        // Determine the direction of the car
+        int car = lanes->dense ? lane_car_at(lanes, cars, row, frog->x) : row_car[occupancy_slot(occupancy, row)];
+        int push_direction = cars->direction[car];
+
+        Frog left = {frog->x - tmp, frog->y};
+        Frog right = {frog->x + tmp, frog->y};
+        if (push_direction == -1 && (occupancy_test_frog(occupancy, occupancy->obstacle, &left) ||
+                                     occupancy_test_frog(occupancy, occupancy->obstacle, &right))) //sprawdzamy czy w okol zaby nie ma zadnej przeszkody w odleglosci tmp
+        {
+            frog->x -= tmp + 1; // jesli tak to poruszamy ja inaczej zeby uniknac przeszkody
+        }
+
+        //Move frog in the direction the car is moving
+        if (push_direction == 1)
+        { //Moving right
+            if (frog->x + tmp < config.playing_area_width - 1) // sprawdzamy czy nie wychodzi poza plancze
+            {
+                frog->x += tmp;
+            }
+            else
+            {
+                frog->x = config.playing_area_width - 2;
+            }
+        }
+        else if (push_direction == -1)
+        { //Moving left
+            if (frog->x - tmp > 1) // tez sprawdzamy czy nie wychodzi poza plansze
+            {
+                frog->x -= tmp;
+            }
+            else
+            {
+                frog->x = 1;
+            }
+        }
+    }
+}
+
+//Check collision between frog and friendly cars
+void check_collision_friendly_car(Frog *frog, CarStore *cars, Occupancy *occupancy, int *row_car, Lanes *lanes, PushingCar *push_car)
+{
+    for (int row = frog->y; row <= frog->y + 1; row++) // oba wiersze zajmowane przez zabe
+    {
+        if (occupancy_test(occupancy, occupancy->friendly, row, frog->x)) // warunek czy zaba jest w kolizji z samochodem
+        {
+            push_car->waiting_to_push = 1; // jesli tak to ustawiamy 1 - czyli ze tak
+            push_car->car_index = lanes->dense ? lane_car_at(lanes, cars, row, frog->x) : row_car[occupancy_slot(occupancy, row)]; // podajemy indeks tego samochodu
+
+            return;
+        }
+    }
+    //Reset if no collision
+    push_car->waiting_to_push;
+    push_car->car_index = -1;
+}
+
+
+
+//FROG FUNCTIONS
+
+//Create frog at starting position
+void create_frog(Frog *frog, int BoardHeight, int BoardWidth)
+{ // Wspolrzedne dla wyrysowania zaby
+    frog->x = BoardWidth / 2;
+    frog->y = BoardHeight - 3;
+}
+
+//Check if frog can jump based on delay (measured in game ticks so it does not depend on the terminal)
+bool frog_jump_delay(int *last_jump_tick, int game_ticks)
+{
+    if (game_ticks - *last_jump_tick >= JumpDelayTicks) // jesli minelo wystarczajaco klatek od ostatniego skoku to mozemy ruszyc zaba
+    {
+        *last_jump_tick = game_ticks; // na nowo nadajemy klatke ostatniego skoku
+        return true;
+    }
+    return false;
+}
+
+//Move frog based on input direction
+void frog_move(Frog *frog, int dir, GameConfig config, Occupancy *occupancy, int *last_jump_tick, int game_ticks)
+{
+    if (!frog_jump_delay(last_jump_tick, game_ticks)) // sprawdzanie czy uplynelo juz wystarczajaco czasu na ruch
+    {
+        return;
+    }
+
+    int new_x = frog->x;
+    int new_y = frog->y;
+
+    if (dir == KEY_UP)
+    {
+        if (frog->y > occupancy->top + 1) // granice widoku, w stalej planszy top == 0
+        {
+            frog->y--;
+        }
+    }
+    if (dir == KEY_DOWN)
+    {
+        if (frog->y < occupancy->top + config.playing_area_height - 3)
+        {
+            frog->y++;
+        }
+    }
+    if (dir == KEY_LEFT)
+    {
+        if (frog->x > 1)
+        {
+            frog->x--;
+        }
+    }
+    if (dir == KEY_RIGHT)
+    {
+        if (frog->x < config.playing_area_width - 2)
+        {
+            frog->x++;
+        }
+    }
+
+    if (check_collision_obstacle(frog, occupancy))
+    {
+        frog->x = new_x;
+        frog->y = new_y;
+    }
+}
+
+//Draw frog on the board
+void draw_frog(WINDOW *board_win, Renderer *renderer, Frog *frog)
+{
+    chtype cell = 'O' | COLOR_PAIR(1); // zaba w swoim kolorze
+    int y = frog->y - renderer->top; // wiersz w widoku
+    put_cells(board_win, renderer, y, frog->x, &cell, 1); //rysujemy zabe
+    put_cells(board_win, renderer, y + 1, frog->x, &cell, 1);
+}
+
+//Delete previous frog from the board after move
+void delete_frog(WINDOW *board_win, Renderer *renderer, Frog *frog)
+{
+    chtype cell = ' ' | COLOR_PAIR(3);
+    int y = frog->y - renderer->top;
+    put_cells(board_win, renderer, y, frog->x, &cell, 1);
+    put_cells(board_win, renderer, y + 1, frog->x, &cell, 1);
+}
+
+
+
+//STATS FUNCTIONS
+
+long long monotonic_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//Bucket of a value: exact below HistogramSubBuckets, then HistogramSubBuckets buckets per power of two
+int histogram_index(uint64_t value)
+{
+    if (value < HistogramSubBuckets)
+    {
+        return (int)value;
+    }
+    int shift = 63 - __builtin_clzll(value) - 4; // HistogramSubBuckets = 2^4
+    return (shift + 1) * HistogramSubBuckets + (int)((value >> shift) & (HistogramSubBuckets - 1));
+}
+
+//Highest value that falls into a bucket
+uint64_t histogram_value(int index)
+{
+    if (index < HistogramSubBuckets)
+    {
+        return (uint64_t)index;
+    }
+    int shift = index / HistogramSubBuckets - 1;
+    return ((uint64_t)(HistogramSubBuckets + index % HistogramSubBuckets + 1) << shift) - 1;
+}
+
+void histogram_record(Histogram *histogram, long long value)
+{
+    uint64_t v = value > 0 ? (uint64_t)value : 0;
+    histogram->counts[histogram_index(v)]++;
+    histogram->count++;
+    histogram->total += v;
+    histogram->max = v > histogram->max ? v : histogram->max;
+}
+
+//Value below which the given fraction of the samples lies
+uint64_t histogram_percentile(Histogram *histogram, double fraction)
+{
+    uint64_t wanted = (uint64_t)(fraction * histogram->count + 0.999999), seen = 0;
+    for (int i = 0; i < HistogramBuckets; i++)
+    {
+        seen += histogram->counts[i];
+        if (seen >= wanted && seen > 0)
+        {
+            uint64_t value = histogram_value(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+//Timestamp for a phase, free when stats are off
+long long stats_start(FrameStats *stats)
+{
+    return stats != nullptr ? monotonic_nsec() : 0;
+}
+
+void stats_stop(FrameStats *stats, Phase phase, long long start)
+{
+    if (stats != nullptr)
+    {
+        histogram_record(&stats->phase[phase], monotonic_nsec() - start);
+    }
+}
+
+const char *phase_name(int phase)
+{
+    const char *names[] = {"input", "tick", "draw", "output", "frame", "latency", "move"};
+    return names[phase];
+}
+
+//On-screen overlay next to display_info, refreshed with the time text
+void display_stats(WINDOW *board_win, Renderer *renderer, FrameStats *stats)
+{
+    int x = getbegx(board_win) + getmaxx(board_win) + 5;
+    if (x + 44 > COLS)
+    {
+        return; // nie ma miejsca obok planszy
+    }
+
+    put_text(stdscr, renderer, StatsRow, x, COLOR_PAIR(7), "%-8s %9s %9s %9s", "us", "p50", "p99", "max");
+    for (int phase = 0; phase < Phases; phase++)
+    {
+        Histogram *histogram = &stats->phase[phase];
+        put_text(stdscr, renderer, StatsRow + 1 + phase, x, COLOR_PAIR(7), "%-8s %9.1f %9.1f %9.1f", phase_name(phase),
+                 histogram_percentile(histogram, 0.5) / 1000.0, histogram_percentile(histogram, 0.99) / 1000.0, histogram->max / 1000.0);
+    }
+}
+
+//Write all phases as a table in microseconds
+int stats_save(FrameStats *stats, const char *file_name)
+{
+    FILE *file = fopen(file_name, "w");
+    if (file == nullptr)
+    {
+        perror("Cannot open stats file");
+        return 1;
+    }
+
+    fprintf(file, "%-8s %10s %10s %10s %10s %10s %10s %10s\n", "phase", "count", "mean_us", "p50_us", "p90_us", "p99_us", "p99.9_us", "max_us");
+    for (int phase = 0; phase < Phases; phase++)
+    {
+        Histogram *histogram = &stats->phase[phase];
+        fprintf(file, "%-8s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", phase_name(phase), (unsigned long long)histogram->count,
+                histogram->count ? histogram->total / 1000.0 / histogram->count : 0.0, histogram_percentile(histogram, 0.5) / 1000.0,
+                histogram_percentile(histogram, 0.9) / 1000.0, histogram_percentile(histogram, 0.99) / 1000.0,
+                histogram_percentile(histogram, 0.999) / 1000.0, histogram->max / 1000.0);
+    }
+    fprintf(file, "%-8s %10ld\n", "coalesced", stats->coalesced_moves);
+    fprintf(file, "%-8s %10ld\n", "dropped", stats->dropped_keys);
+
+    fclose(file);
+    return 0;
+}
+
+
+//RENDER FUNCTIONS
+
+//Copy cells of the static layer back onto the board
+void restore_cells(WINDOW *board_win, Renderer *renderer, int y, int x, int count)
+{
+    if (y < 0 || y >= renderer->rows)
+    {
+        return;
+    }
+    if (x < 0)
+    {
+        count += x;
+        x = 0;
+    }
+    if (x + count > renderer->cols)
+    {
+        count = renderer->cols - x;
+    }
+    if (count > 0)
+    {
+        put_cells(board_win, renderer, y, x, renderer->static_cells + y * renderer->cols + x, count);
+    }
+}
+
+//Static layer of the rows in view: border, roads, finish and obstacles
+void renderer_build_static(Renderer *renderer, Simulation *sim)
+{
+    Occupancy *occupancy = &sim->occupancy;
+    renderer->top = occupancy->top;
+
+    build_board(renderer);
+    if (!sim->config.endless)
+    {
+        build_roads(sim->used_flags, renderer);
+        creare_finish(renderer, &sim->finish, sim->config);
+        build_obstacles(renderer, sim->obstacle, sim->config.number_of_obstacles);
+        return;
+    }
+
+    //Endless: roads through the ring, obstacles shifted into the view, the frame stays on top
+    for (int y = 1; y < renderer->rows - 1; y++)
+    {
+        if (sim->used_flags[occupancy_slot(occupancy, occupancy->top + y)])
+        {
+            build_one_road(renderer, y);
+        }
+    }
+    for (int i = 0; i < sim->config.number_of_obstacles; i++)
+    {
+        int y = sim->obstacle[i].y - occupancy->top;
+        if (y > 0 && y < renderer->rows - 1)
+        {
+            set_static_cell(renderer, y, sim->obstacle[i].x, '#' | COLOR_PAIR(6));
+        }
+    }
+}
+
+//Build the static layer once from the board layout
+int renderer_init(Renderer *renderer, Simulation *sim)
+{
+    renderer->rows = sim->config.playing_area_height;
+    renderer->cols = sim->config.playing_area_width;
+    renderer->static_cells = (chtype *)malloc(sizeof(chtype) * renderer->rows * renderer->cols);
+    renderer->car_pair = (int *)malloc(sizeof(int) * (sim->cars.count + 1));
+    renderer->drawn_car_x = (int *)malloc(sizeof(int) * (sim->cars.count + 1));
+    if (renderer->static_cells == nullptr || renderer->car_pair == nullptr || renderer->drawn_car_x == nullptr)
+    {
+        perror("Cannot allocate static layer");
+        free(renderer->static_cells);
+        free(renderer->car_pair);
+        free(renderer->drawn_car_x);
+        return 1;
+    }
+
+    renderer_build_static(renderer, sim);
+    initialize_car_pairs(renderer, &sim->cars);
+    renderer->drawn_frog = sim->frog;
+    renderer->drawn_time = -1;
+    renderer->stats = nullptr;
+    renderer->ansi = nullptr;
+    renderer->spectators = nullptr;
+    return 0;
+}
+
+void renderer_free(Renderer *renderer)
+{
+    free(renderer->static_cells);
+    free(renderer->car_pair);
+    free(renderer->drawn_car_x);
+    renderer->static_cells = nullptr;
+}
+
+//Blit the whole static layer and draw every dynamic element
+void draw_full_frame(WINDOW *board_win, Renderer *renderer, Simulation *sim)
+{
+    for (int y = 0; y < renderer->rows; y++) // kazdy wiersz jednym wywolaniem
+    {
+        restore_cells(board_win, renderer, y, 0, renderer->cols);
+    }
+    draw_cars(board_win, renderer, &sim->cars);
+    draw_frog(board_win, renderer, &sim->frog);
+    renderer->drawn_frog = sim->frog;
+}
+
+//Redraw only the cells that changed since the last frame
+void draw_changed_cells(WINDOW *board_win, Renderer *renderer, Simulation *sim)
+{
+    //The view scrolled: every row moved, so the whole board is drawn again
+    if (renderer->top != sim->occupancy.top)
+    {
+        renderer_build_static(renderer, sim);
+        draw_full_frame(board_win, renderer, sim);
+        renderer->drawn_time = -1; // razem z dystansem w display_info
+        return;
+    }
+
+    int top = renderer->top;
+    Frog old_frog = renderer->drawn_frog;
+    bool frog_moved = old_frog.x != sim->frog.x || old_frog.y != sim->frog.y;
+
+    //Erase old positions first, so no erase can wipe a freshly drawn element
+    if (frog_moved)
+    {
+        restore_cells(board_win, renderer, old_frog.y - top, old_frog.x, 1);
+        restore_cells(board_win, renderer, old_frog.y + 1 - top, old_frog.x, 1);
+    }
+    CarStore *cars = &sim->cars;
+    for (int i = 0; i < cars->count; i++)
+    {
+        if (renderer->drawn_car_x[i] != cars->x[i])
+        {
+            restore_cells(board_win, renderer, cars->y[i] - top, renderer->drawn_car_x[i], 3);
+        }
+    }
+
+    //Draw cars that moved, and cars uncovered by the frog leaving them
+    for (int i = 0; i < cars->count; i++)
+    {
+        if (renderer->drawn_car_x[i] != cars->x[i] || (frog_moved && frog_on_car(&old_frog, cars, i)))
+        {
+            draw_car(board_win, renderer, cars->x[i], cars->y[i] - top, renderer->car_pair[i]);
+            renderer->drawn_car_x[i] = cars->x[i];
+        }
+    }
+
+    draw_frog(board_win, renderer, &sim->frog); // zaba zawsze na wierzchu, to tylko dwa pola
+    renderer->drawn_frog = sim->frog;
+}
+
+//RECORDING FUNCTIONS
+
+int key_to_code(int key)
+{
+    switch (key)
+    {
+        case KEY_UP: return ReplayUp;
+        case KEY_DOWN: return ReplayDown;
+        case KEY_LEFT: return ReplayLeft;
+        case KEY_RIGHT: return ReplayRight;
+        case 'e': return ReplayPush;
+        default: return ReplayOther; // inne klawisze tez zuzywaja opoznienie skoku
+    }
+}
+
+int code_to_key(int code)
+{
+    int keys[] = {KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, 'e', 'x'};
+    return keys[code];
+}
+
+void recording_put_byte(Recording *recording, unsigned char byte)
+{
+    if (recording->size == recording->capacity)
+    {
+        size_t capacity = recording->capacity ? recording->capacity * 2 : 4096;
+        unsigned char *data = (unsigned char *)realloc(recording->data, capacity);
+        if (data == nullptr)
+        {
+            return; // brak pamieci, zapis bedzie niepelny
+        }
+        recording->data = data;
+        recording->capacity = capacity;
+    }
+    recording->data[recording->size++] = byte;
+}
+
+void recording_put_varint(Recording *recording, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        recording_put_byte(recording, (unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    recording_put_byte(recording, (unsigned char)value);
+}
+
+//Append one key pressed at the given tick
+void recording_add(Recording *recording, int tick, int key)
+{
+    recording_put_varint(recording, ((uint64_t)(tick - recording->last_tick) << 3) | key_to_code(key));
+    recording->last_tick = tick;
+}
+
+//End marker with the last tick and the outcome
+void recording_finish(Recording *recording, int tick, int state)
+{
+    recording_put_varint(recording, ((uint64_t)(tick - recording->last_tick) << 3) | ReplayEnd);
+    recording_put_byte(recording, (unsigned char)state);
+}
+
+//Write seed, config, the key stream and the outcome of the finished game
+int recording_save(Recording *recording, const char *file_name, Simulation *sim)
+{
+    FILE *file = fopen(file_name, "wb");
+    if (file == nullptr)
+    {
+        perror("Cannot open recording file");
+        return 1;
+    }
+
+    fwrite("JFRP", 1, 4, file);
+    fputc(ReplayVersion, file);
+    write_int(file, sim->seed, 8);
+    config_write(file, &sim->config);
+    fputc(sim->config.endless ? 1 : 0, file); // flagi
+
+    recording_finish(recording, sim->game_ticks, sim->state);
+    fwrite(recording->data, 1, recording->size, file);
+
+    bool failed = ferror(file) != 0; // bledy wszystkich zapisow wyzej
+    if (fclose(file) != 0 || failed)
+    {
+        perror("Cannot write recording file");
+        return 1;
+    }
+    return 0;
+}
+
+void recording_free(Recording *recording)
+{
+    free(recording->data);
+    recording->data = nullptr;
+}
+
+bool replay_get_varint(ReplayReader *reader, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; reader->pos < reader->end && shift < 64; shift += 7)
+    {
+        unsigned char byte = *reader->pos++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Read the next event, the end marker also reads the outcome
+bool replay_next(ReplayReader *reader)
+{
+    uint64_t value;
+    if (!replay_get_varint(reader, &value))
+    {
+        return false;
+    }
+    reader->next_tick += (int)(value >> 3);
+    reader->next_code = (int)(value & 7);
+    if (reader->next_code > ReplayOther && reader->next_code != ReplayEnd)
+    {
+        fprintf(stderr, "Corrupt recording: unknown key code %d at tick %d\n", reader->next_code, reader->next_tick);
+        reader->next_code = ReplayEnd; // nic z tego kodu nie trafi do code_to_key
+        reader->corrupt = true;
+        return false;
+    }
+    if (reader->next_code == ReplayEnd)
+    {
+        if (reader->pos >= reader->end)
+        {
+            return false;
+        }
+        reader->end_tick = reader->next_tick;
+        reader->outcome = *reader->pos++;
+    }
+    return true;
+}
+
+//Start reading a key stream kept in memory
+bool replay_start(ReplayReader *reader, const unsigned char *data, size_t size)
+{
+    reader->pos = data;
+    reader->end = data + size;
+    reader->next_tick = 0;
+    reader->end_tick = -1;
+    reader->outcome = SimRunning;
+    reader->corrupt = false;
+    return replay_next(reader);
+}
+
+//Map a recording into memory and read its header
+const unsigned char *replay_open(const char *file_name, size_t *size, ReplayReader *reader, GameConfig *config, uint64_t *seed)
+{
+    int fd = open(file_name, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        perror("Cannot open replay file");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return nullptr;
+    }
+
+    int header = 4 + 1 + 8 + 7 * 4 + 1;
+    *size = (size_t)info.st_size;
+    void *data = *size >= (size_t)header - 1 ? mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd); // mapowanie zostaje po zamknieciu pliku
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Cannot map replay file: %s\n", file_name);
+        return nullptr;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)data;
+    if (memcmp(bytes, "JFRP", 4) != 0 || (bytes[4] != ReplayVersion && bytes[4] != 2))
+    {
+        fprintf(stderr, "Not a replay file: %s\n", file_name);
+        munmap(data, *size);
+        return nullptr;
+    }
+
+    *seed = read_int(bytes + 5, 8);
+    config_read(bytes + 13, config);
+    if (bytes[4] == 2) // wersja 2 nie ma bajtu flag
+    {
+        header--;
+    }
+    else if (*size < (size_t)header)
+    {
+        fprintf(stderr, "Replay file is truncated: %s\n", file_name);
+        munmap(data, *size);
+        return nullptr;
+    }
+    else
+    {
+        config->endless = bytes[header - 1] & 1;
+    }
+
+    if (!replay_start(reader, bytes + header, *size - header))
+    {
+        fprintf(stderr, "Replay file is %s: %s\n", reader->corrupt ? "corrupt" : "truncated", file_name);
+        munmap(data, *size);
+        return nullptr;
+    }
+    return bytes;
+}
+
+//EVENT LOG FUNCTIONS
+
+//Append an event without ever blocking the game: a full ring drops it
+void event_log_push(EventLog *log, int tick, EventKind kind, int x, int y, int value)
+{
+    uint64_t head = log->head.load(memory_order_relaxed);
+    if (head - log->cached_tail > log->mask)
+    {
+        log->cached_tail = log->tail.load(memory_order_acquire);
+        if (head - log->cached_tail > log->mask)
+        {
+            log->dropped++;
+            return;
+        }
+    }
+
+    GameEvent *event = &log->events[head & log->mask];
+    event->tick = tick;
+    event->kind = kind;
+    event->x = x;
+    event->y = y;
+    event->value = value;
+    log->head.store(head + 1, memory_order_release); // zdarzenie widoczne dla watku zapisu dopiero gotowe
+}
+
+//One event as a JSON line
+void event_write(FILE *file, GameEvent *event)
+{
+    const char *names[EventKinds] = {"move", "push", "halt", "death", "win"};
+    const char *values[EventKinds] = {nullptr, "car", "car", nullptr, "score"}; // nazwa pola value
+
+    fprintf(file, "{\"tick\":%d,\"event\":\"%s\",\"x\":%d,\"y\":%d", event->tick, names[event->kind], event->x, event->y);
+    if (values[event->kind] != nullptr)
+    {
+        fprintf(file, ",\"%s\":%d", values[event->kind], event->value);
+    }
+    fputs("}\n", file);
+}
+
+//Writer thread: drain whatever was published in one batch, one flush per batch, sleep when idle
+void event_log_writer(EventLog *log)
+{
+    while (true)
+    {
+        bool stopping = log->stop.load(memory_order_acquire); // przed head, zeby ostatnie zdarzenia tez poszly
+        uint64_t tail = log->tail.load(memory_order_relaxed);
+        uint64_t head = log->head.load(memory_order_acquire);
+
+        for (; tail != head; tail++)
+        {
+            event_write(log->file, &log->events[tail & log->mask]);
+        }
+        log->tail.store(tail, memory_order_release); // miejsca wolne dla watku gry
+        fflush(log->file);
+
+        if (stopping)
+        {
+            return;
+        }
+        usleep(EventFlushDelay);
+    }
+}
+
+//Open the file, write the game header line and start the writer thread
+int event_log_open(EventLog *log, const char *file_name, Simulation *sim)
+{
+    log->file = fopen(file_name, "w");
+    log->events = (GameEvent *)malloc(sizeof(GameEvent) * EventLogSize);
+    if (log->file == nullptr || log->events == nullptr)
+    {
+        perror("Cannot open event log");
+        if (log->file != nullptr)
+        {
+            fclose(log->file);
+        }
+        free(log->events);
+        return 1;
+    }
+
+    GameConfig *config = &sim->config;
+    fprintf(log->file, "{\"event\":\"start\",\"seed\":%llu,\"width\":%d,\"height\":%d,\"endless\":%d}\n",
+            (unsigned long long)sim->seed, config->playing_area_width, config->playing_area_height, config->endless);
+    log->mask = EventLogSize - 1;
+    log->head.store(0, memory_order_relaxed);
+    log->tail.store(0, memory_order_relaxed);
+    log->cached_tail = 0;
+    log->dropped = 0;
+    log->stop.store(false, memory_order_relaxed);
+    log->writer = thread(event_log_writer, log); // start watku publikuje wszystko powyzej
+    return 0;
+}
+
+//Stop the writer after it drained the ring, then note how many events were lost
+int event_log_close(EventLog *log)
+{
+    log->stop.store(true, memory_order_release);
+    log->writer.join();
+    if (log->dropped > 0)
+    {
+        fprintf(log->file, "{\"event\":\"dropped\",\"count\":%ld}\n", log->dropped);
+    }
+    int result = fclose(log->file) == 0 ? 0 : 1;
+    free(log->events);
+    return result;
+}
+
+
+//ENDLESS FUNCTIONS
+
+//Rows travelled in endless mode: how far the view scrolled from the start
+int endless_distance(Simulation *sim)
+{
+    return -sim->occupancy.top;
+}
+
+//Take a parked car for the new road at world row y
+void endless_place_car(Simulation *sim, int i, int y, int slot)
+{
+    CarStore *cars = &sim->cars;
+    uint64_t *layers[CarKinds] = {sim->occupancy.hostile, sim->occupancy.friendly, sim->occupancy.stopping};
+
+    cars->y[i] = y;
+    cars->x[i] = get_random_number(&sim->rng, 4, sim->config.playing_area_width - 6); // jak w initialize_cars
+    cars->direction[i] = (get_random_number(&sim->rng, 0, 1) == 0) ? 1 : -1;
+    cars->speed[i] = get_random_number(&sim->rng, 1, 3);
+    cars->is_static[i] = false;
+    cars->old_x[i] = cars->x[i];
+    sim->used_flags[slot] = 1;
+    sim->row_car[slot] = i;
+    occupancy_mark_car(&sim->occupancy, layers[car_kind(cars, i)], y, cars->x[i], true);
+}
+
+//Fill the row entering at the top: a road while parked cars are left, otherwise maybe an obstacle,
+//with the same odds as rows 2 to rows - 4 of the first board
+void endless_fill_row(Simulation *sim, int y, int slot)
+{
+    GameConfig *config = &sim->config;
+    CarStore *cars = &sim->cars;
+    int candidates = config->playing_area_height - 5; // wiersze na drogi w pierwszej planszy
+
+    if (cars->count > 0 && get_random_number(&sim->rng, 1, candidates) <= config->number_of_roads)
+    {
+        int start = get_random_number(&sim->rng, 0, cars->count - 1); // losowy rodzaj samochodu, bez przesuwania tablic
+        for (int k = 0; k < cars->count; k++)
+        {
+            int i = (start + k) % cars->count;
+            if (cars->y[i] == ParkedRow)
+            {
+                endless_place_car(sim, i, y, slot);
+                return;
+            }
+        }
+    }
+    if (config->number_of_obstacles > 0 && get_random_number(&sim->rng, 1, candidates - config->number_of_roads) <= config->number_of_obstacles)
+    {
+        for (int i = 0; i < config->number_of_obstacles; i++)
+        {
+            if (sim->obstacle[i].y == ParkedRow)
+            {
+                sim->obstacle[i].y = y;
+                sim->obstacle[i].x = get_random_number(&sim->rng, 1, config->playing_area_width - 6);
+                occupancy_set(&sim->occupancy, sim->occupancy.obstacle, y, sim->obstacle[i].x, true);
+                return;
+            }
+        }
+    }
+}
+
+//Scroll the view one row up the world: the slot of the bottom row is recycled for the new top row
+void endless_scroll(Simulation *sim)
+{
+    Occupancy *occupancy = &sim->occupancy;
+    CarStore *cars = &sim->cars;
+    int leaving = occupancy->top + occupancy->rows - 1; // wiersz swiata znikajacy pod dolna ramka
+    int slot = occupancy_slot(occupancy, leaving);
+
+    //Its car and obstacle wait for a new row
+    int car = sim->row_car[slot];
+    if (car >= 0)
+    {
+        cars->y[car] = ParkedRow;
+        if (sim->push_car.car_index == car)
+        {
+            sim->push_car.waiting_to_push = 0;
+            sim->push_car.car_index = -1;
+        }
+    }
+    for (int i = 0; i < sim->config.number_of_obstacles; i++)
+    {
+        if (sim->obstacle[i].y == leaving)
+        {
+            sim->obstacle[i].y = ParkedRow;
+        }
+    }
+
+    uint64_t *layers[4] = {occupancy->obstacle, occupancy->hostile, occupancy->friendly, occupancy->stopping};
+    for (int k = 0; k < 4; k++)
+    {
+        memset(layers[k] + (size_t)slot * occupancy->words, 0, sizeof(uint64_t) * occupancy->words);
+    }
+    sim->used_flags[slot] = 0;
+    sim->row_car[slot] = -1;
+
+    occupancy->top--;
+    occupancy->base = slot; // wolne miejsce jest teraz gornym wierszem
+    endless_fill_row(sim, occupancy->top, slot);
+}
+
+//Keep the frog in the lower half of the view
+void endless_follow(Simulation *sim)
+{
+    while (sim->frog.y - sim->occupancy.top < sim->config.playing_area_height / 2)
+    {
+        endless_scroll(sim);
+    }
+}
+
+
+//SIMULATION FUNCTIONS
+
+void initialize_game_elements(Simulation *sim)
+{
+    GameConfig *config = &sim->config;
+
+    initialize_flags(sim->used_flags, config->playing_area_height);
+    get_random_road(&sim->rng, sim->used_flags, config->playing_area_height, config->number_of_roads);
+    if (sim->lanes.dense)
+    {
+        initialize_lanes(&sim->rng, &sim->cars, &sim->lanes, sim->used_flags, *config, sim->roads, sim->shuffle);
+    }
+    else
+    {
+        initialize_cars(&sim->rng, &sim->cars, sim->used_flags, *config, sim->roads, sim->positions, sim->shuffle);
+    }
+    initialize_obstacle(&sim->rng, sim->obstacle, config->number_of_obstacles, sim->used_flags, config->playing_area_height,
+                        config->playing_area_width, sim->shuffle);
+    create_frog(&sim->frog, config->playing_area_height, config->playing_area_width);
+}
+
+//Fill occupancy layers and the row to car lookup from the placed elements
+void initialize_occupancy(Simulation *sim)
+{
+    Occupancy *occupancy = &sim->occupancy;
+
+    for (int y = 0; y < sim->config.playing_area_height; y++)
+    {
+        sim->row_car[y] = -1;
+    }
+    for (int i = 0; i < sim->config.number_of_obstacles; i++)
+    {
+        occupancy_set(occupancy, occupancy->obstacle, sim->obstacle[i].y, sim->obstacle[i].x, true);
+    }
+
+    uint64_t *layers[CarKinds] = {occupancy->hostile, occupancy->friendly, occupancy->stopping};
+    CarStore *cars = &sim->cars;
+    for (int i = 0; i < cars->count; i++)
+    {
+        if (!sim->lanes.dense)
+        {
+            sim->row_car[cars->y[i]] = i; // na kazdej drodze jest jeden samochod, w gestym ruchu szukamy w pasie
+        }
+        occupancy_mark_car(occupancy, layers[car_kind(cars, i)], cars->y[i], cars->x[i], true);
+    }
+}
+
+//Carve every per-game array out of the arena (only measures when the arena has no memory)
+void simulation_carve(Simulation *sim, Arena *arena)
+{
+    GameConfig config = sim->config;
+    int rows = config.playing_area_height;
+    int cars = config.number_of_hostile_cars + config.number_of_friendly_cars + config.number_of_stopping_cars;
+
+    sim->used_flags = (int *)arena_alloc(arena, sizeof(int) * rows); // flagi drog dla kazdego wiersza planszy
+    sim->row_car = (int *)arena_alloc(arena, sizeof(int) * rows);
+    sim->roads = (int *)arena_alloc(arena, sizeof(int) * config.number_of_roads);
+    sim->positions = (int *)arena_alloc(arena, sizeof(int) * cars);
+    int shuffle = rows > config.number_of_roads ? rows : config.number_of_roads;
+    sim->shuffle = (int *)arena_alloc(arena, sizeof(int) * (shuffle > cars ? shuffle : cars));
+    sim->obstacle = (Obstacle *)arena_alloc(arena, sizeof(Obstacle) * config.number_of_obstacles);
+    car_store_init(&sim->cars, arena, config);
+    Lanes *lanes = &sim->lanes;
+    lanes->dense = cars > config.number_of_roads;
+    lanes->rows = rows;
+    lanes->begin = (int *)arena_alloc(arena, sizeof(int) * (config.number_of_roads + 1));
+    lanes->cars = (int *)arena_alloc(arena, sizeof(int) * cars);
+    lanes->y = (int *)arena_alloc(arena, sizeof(int) * config.number_of_roads);
+    lanes->direction = (int *)arena_alloc(arena, sizeof(int) * config.number_of_roads);
+    lanes->row_lane = (int *)arena_alloc(arena, sizeof(int) * rows);
+    lanes->step = (int *)arena_alloc(arena, sizeof(int) * cars);
+    occupancy_init(&sim->occupancy, arena, rows, config.playing_area_width);
+}
+
+//Start a new game with the given seed in the already allocated arena
+void simulation_reset(Simulation *sim, uint64_t seed)
+{
+    memset(sim->arena.base, 0, sim->arena.size);
+    sim->occupancy.top = 0; // widok na poczatku swiata
+    sim->occupancy.base = 0;
+    sim->seed = seed;
+    rng_seed(&sim->rng, seed); // kazda gra ma wlasny generator
+    rng_seed(&sim->hostile_rng, seed ^ 0xD1B54A32D192ED03ULL);
+
+    initialize_game_elements(sim);
+    initialize_occupancy(sim);
+
+    sim->finish.x = sim->config.playing_area_width / 2; // meta na srodku gornej krawedzi
+    sim->finish.y = sim->config.endless ? ParkedRow : 1; // bez mety w trybie endless
+    sim->push_car.waiting_to_push = 0;
+    sim->push_car.car_index = -1;
+    sim->game_ticks = 0;
+    sim->last_jump_tick = -JumpDelayTicks; // pierwszy skok jest dozwolony od razu
+    sim->state = SimRunning;
+}
+
+//Create a new game without touching the terminal
+int simulation_init(Simulation *sim, GameConfig config, uint64_t seed)
+{
+    sim->config = config;
+    sim->recording = nullptr;
+    sim->events = nullptr;
+
+    //First pass measures, second pass hands out the memory
+    Arena measure = {nullptr, 0, 0};
+    simulation_carve(sim, &measure);
+
+    sim->arena.base = (char *)aligned_alloc(64, (measure.used + 63) & ~(size_t)63);
+    sim->arena.size = measure.used;
+    sim->arena.used = 0;
+    if (sim->arena.base == nullptr)
+    {
+        perror("Cannot allocate game memory");
+        return 1;
+    }
+    simulation_carve(sim, &sim->arena);
+
+    simulation_reset(sim, seed);
+    return 0;
+}
+
+void simulation_free(Simulation *sim)
+{
+    free(sim->arena.base);
+    sim->arena.base = nullptr;
+}
+
+//Game time shown to the player, counted in ticks so it follows the clock scale
+int game_seconds(Simulation *sim)
+{
+    return (int)((long)sim->game_ticks * FrameDelay / 1000000);
+}
+
+//Check end of game conditions and friendly car contact after every change of the board
+void simulation_check(Simulation *sim)
+{
+    if (check_collision_hostile_car(&sim->frog, &sim->occupancy))
+    {
+        sim->state = SimLost;
+        if (sim->events != nullptr)
+        {
+            event_log_push(sim->events, sim->game_ticks, EventDeath, sim->frog.x, sim->frog.y, 0);
+        }
+        return;
+    }
+
+    check_collision_friendly_car(&sim->frog, &sim->cars, &sim->occupancy, sim->row_car, &sim->lanes, &sim->push_car);
+
+    if (check_finish_collision(&sim->frog, &sim->finish))
+    {
+        sim->state = SimWon;
+        if (sim->events != nullptr)
+        {
+            int seconds = game_seconds(sim);
+            int score = sim->config.playing_area_width / (seconds > 0 ? seconds : 1) * 3; // jak w display_win_message
+            event_log_push(sim->events, sim->game_ticks, EventWin, sim->frog.x, sim->frog.y, score);
+        }
+    }
+}
+
+//Apply one key (or ERR for no key) at the current tick
+void simulation_input(Simulation *sim, int move_input)
+{
+    if (sim->state != SimRunning || move_input == ERR)
+    {
+        return;
+    }
+    if (sim->recording != nullptr)
+    {
+        recording_add(sim->recording, sim->game_ticks, move_input); // kazdy klawisz z numerem klatki
+    }
+
+    //Check if friendly car should wait for input
+    if (sim->push_car.waiting_to_push) // friendly samochod czeka na klikniecie 'e' by moc sie przesunac
+    {
+        if (move_input == 'e')
+        {
+            move_frog_by_car(&sim->frog, &sim->cars, sim->config, &sim->occupancy, sim->row_car, &sim->lanes);
+            if (sim->events != nullptr)
+            {
+                event_log_push(sim->events, sim->game_ticks, EventPush, sim->frog.x, sim->frog.y, sim->push_car.car_index);
+            }
+
+            sim->push_car.waiting_to_push = 0; // aktualizujemy samochod ze juz ruszony
+            sim->push_car.car_index = -1; // cofamy indeks samochodu na zaden
+        }
+    }
+
+    Frog before = sim->frog;
+    frog_move(&sim->frog, move_input, sim->config, &sim->occupancy, &sim->last_jump_tick, sim->game_ticks);
+    if (sim->events != nullptr && (before.x != sim->frog.x || before.y != sim->frog.y))
+    {
+        event_log_push(sim->events, sim->game_ticks, EventMove, sim->frog.x, sim->frog.y, 0);
+    }
+    simulation_check(sim);
+    if (sim->config.endless && sim->state == SimRunning)
+    {
+        endless_follow(sim);
+    }
+}
+
+//Move all cars by one tick
+void simulation_tick(Simulation *sim)
+{
+    if (sim->state != SimRunning)
+    {
+        return;
+    }
+
+    if (sim->lanes.dense)
+    {
+        move_lanes(sim);
+    }
+    else
+    {
+        move_cars(&sim->cars, sim->config, sim->game_ticks, &sim->frog, &sim->push_car, &sim->occupancy, &sim->rng, &sim->hostile_rng);
+    }
+    sim->game_ticks++; // zwiekszamy licznik klatek gry
+    if (sim->events != nullptr)
+    {
+        CarStore *cars = &sim->cars;
+        for (int i = cars->begin[CarStopping]; i < cars->begin[CarStopping + 1]; i++)
+        {
+            if (cars->edge[i]) // flaga z move_stopping_cars
+            {
+                event_log_push(sim->events, sim->game_ticks, EventHalt, cars->x[i], cars->y[i], i);
+            }
+        }
+    }
+    simulation_check(sim);
+}
+
+//Advance one tick from an explicit input
+SimState simulation_step(Simulation *sim, int move_input)
+{
+    simulation_input(sim, move_input);
+    simulation_tick(sim);
+    return sim->state;
+}
+
+//SNAPSHOT FUNCTIONS
+
+//Bytes of one snapshot of this game: the header and one word per car
+size_t snapshot_size(Simulation *sim)
+{
+    return sizeof(Snapshot) + sizeof(uint32_t) * sim->cars.count;
+}
+
+//Copy the changing part of the game into snapshot_size(sim) bytes; false for an endless game, whose rows, obstacles
+//and car roads keep changing and are not part of a snapshot
+bool snapshot(Simulation *sim, Snapshot *out)
+{
+    if (sim->config.endless)
+    {
+        return false;
+    }
+    out->seed = sim->seed;
+    out->rng = sim->rng;
+    out->hostile_rng = sim->hostile_rng;
+    out->game_ticks = sim->game_ticks;
+    out->last_jump_tick = sim->last_jump_tick;
+    out->push_car_index = sim->push_car.car_index;
+    out->frog_x = sim->frog.x;
+    out->frog_y = sim->frog.y;
+    out->flags = (uint32_t)sim->state | (uint32_t)(sim->push_car.waiting_to_push != 0) << 2;
+
+    CarStore *cars = &sim->cars;
+    uint32_t *words = (uint32_t *)(out + 1);
+    for (int i = 0; i < cars->count; i++) // x w 24 bitach, kierunek, predkosc 1..3, postoj
+    {
+        words[i] = ((uint32_t)cars->x[i] & 0xFFFFFF) | (uint32_t)(cars->direction[i] < 0) << 24 | (uint32_t)cars->speed[i] << 25 |
+                   (uint32_t)(cars->is_static[i] != 0) << 27;
+    }
+    return true;
+}
+
+//Put the game back into the snapshotted state; a snapshot of another level first rebuilds that level from its seed.
+//False for an endless game, which snapshot refuses as well
+bool restore(Simulation *sim, const Snapshot *in)
+{
+    if (sim->config.endless)
+    {
+        return false;
+    }
+    if (sim->seed != in->seed)
+    {
+        simulation_reset(sim, in->seed);
+    }
+    sim->rng = in->rng;
+    sim->hostile_rng = in->hostile_rng;
+    sim->game_ticks = in->game_ticks;
+    sim->last_jump_tick = in->last_jump_tick;
+    sim->push_car.car_index = in->push_car_index;
+    sim->push_car.waiting_to_push = (in->flags >> 2) & 1;
+    sim->frog.x = in->frog_x;
+    sim->frog.y = in->frog_y;
+    sim->state = (SimState)(in->flags & 3);
+
+    //Occupancy of the cars: all of them off, then all of them on at the restored positions
+    CarStore *cars = &sim->cars;
+    Occupancy *occupancy = &sim->occupancy;
+    uint64_t *layers[CarKinds] = {occupancy->hostile, occupancy->friendly, occupancy->stopping};
+    const uint32_t *words = (const uint32_t *)(in + 1);
+    for (int kind = 0; kind < CarKinds; kind++)
+    {
+        for (int i = cars->begin[kind]; i < cars->begin[kind + 1]; i++)
+        {
+            occupancy_mark_car(occupancy, layers[kind], cars->y[i], cars->x[i], false);
+        }
+    }
+    for (int kind = 0; kind < CarKinds; kind++)
+    {
+        for (int i = cars->begin[kind]; i < cars->begin[kind + 1]; i++)
+        {
+            uint32_t word = words[i];
+            cars->x[i] = (int32_t)(word << 8) >> 8; // rozszerzenie znaku z 24 bitow
+            cars->direction[i] = (word >> 24) & 1 ? -1 : 1;
+            cars->speed[i] = (word >> 25) & 3;
+            cars->is_static[i] = (word >> 27) & 1;
+            occupancy_mark_car(occupancy, layers[kind], cars->y[i], cars->x[i], true);
+        }
+    }
+    if (sim->lanes.dense)
+    {
+        lanes_sort(&sim->lanes, cars); // samochody, ktore zawinely, sa w innym miejscu pasa
+    }
+    return true;
+}
+
+//Zobrist key of one word of a snapshot; computed instead of tabled, since a word has 2^32 values
+uint64_t zobrist_key(uint64_t slot, uint32_t value)
+{
+    uint64_t z = (slot << 32 | value) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+//XOR of the keys of all words: a change of one word changes the hash by key(old) ^ key(new)
+uint64_t snapshot_hash(const Snapshot *snap, size_t size)
+{
+    const uint32_t *words = (const uint32_t *)snap;
+    uint64_t hash = 0;
+    for (size_t i = 0; i < size / sizeof(uint32_t); i++)
+    {
+        hash ^= zobrist_key(i, words[i]);
+    }
+    return hash != 0 ? hash : 1; // 0 oznacza puste pole tablicy transpozycji
+}
+
+bool tt_init(TranspositionTable *table, int bits)
+{
+    table->mask = ((size_t)1 << bits) - 1;
+    table->keys = (uint64_t *)calloc(table->mask + 1, sizeof(uint64_t));
+    table->values = (int *)malloc(sizeof(int) * (table->mask + 1));
+    if (table->keys == nullptr || table->values == nullptr)
+    {
+        perror("Cannot allocate transposition table");
+        free(table->keys);
+        free(table->values);
+        table->keys = nullptr;
+        table->values = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool tt_probe(TranspositionTable *table, uint64_t key, int *value)
+{
+    size_t i = (size_t)key & table->mask;
+    if (table->keys[i] != key)
+    {
+        return false;
+    }
+    *value = table->values[i];
+    return true;
+}
+
+//Newest result wins its slot, a lost entry is only searched again
+void tt_store(TranspositionTable *table, uint64_t key, int value)
+{
+    size_t i = (size_t)key & table->mask;
+    table->keys[i] = key;
+    table->values[i] = value;
+}
+
+void tt_free(TranspositionTable *table)
+{
+    free(table->keys);
+    free(table->values);
+    table->keys = nullptr;
+    table->values = nullptr;
+}
+
+
+//SPECTATOR FUNCTIONS
+
+//One frame: tick, state, frog, top row, then x and y of every car and obstacle and the road flag of every row in view
+int spectator_frame_ints(GameConfig *config)
+{
+    int cars = config->number_of_hostile_cars + config->number_of_friendly_cars + config->number_of_stopping_cars;
+    return 5 + 2 * cars + 2 * config->number_of_obstacles + config->playing_area_height;
+}
+
+//Header rounded up to a cache line, slots start right after it
+size_t spectator_header_size()
+{
+    return (sizeof(SpectatorHeader) + 63) & ~(size_t)63;
+}
+
+//Sequence number of the slot that holds a frame: odd while it is written, 2 * frame when it is ready
+atomic<uint64_t> *spectator_slot(SpectatorRing *ring, uint64_t frame)
+{
+    char *slots = (char *)ring->header + spectator_header_size();
+    return (atomic<uint64_t> *)(slots + (frame % SpectatorSlots) * ring->header->slot_size);
+}
+
+//Create the shared file and describe the game in its header
+int spectator_create(SpectatorRing *ring, const char *file_name, Simulation *sim)
+{
+    int frame_ints = spectator_frame_ints(&sim->config);
+    int slot_size = (int)((sizeof(uint64_t) + sizeof(int) * frame_ints + 63) & ~(size_t)63);
+    size_t size = spectator_header_size() + (size_t)slot_size * SpectatorSlots;
+
+    int fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    void *data = fd >= 0 && ftruncate(fd, size) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (fd >= 0)
+    {
+        close(fd); // mapowanie zostaje po zamknieciu pliku
+    }
+    if (data == MAP_FAILED)
+    {
+        perror("Cannot create spectator file");
+        return 1;
+    }
+
+    //ftruncate zeroes the file, so published == 0 until the first frame
+    ring->header = (SpectatorHeader *)data;
+    ring->size = size;
+    ring->frame = 0;
+    ring->copy = nullptr;
+    SpectatorHeader *header = ring->header;
+    header->version = SpectatorVersion;
+    header->seed = sim->seed;
+    header->config = sim->config;
+    header->frame_ints = frame_ints;
+    header->slot_size = slot_size;
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, "JFSP", 4); // na koncu, widz nie przeczyta niepelnego naglowka
+    return 0;
+}
+
+//Write the state the renderer draws into spectator_frame_ints ints
+void frame_encode(Simulation *sim, int *data)
+{
+    Occupancy *occupancy = &sim->occupancy;
+    CarStore *cars = &sim->cars;
+    int obstacles = sim->config.number_of_obstacles;
+    data[0] = sim->game_ticks;
+    data[1] = sim->state;
+    data[2] = sim->frog.x;
+    data[3] = sim->frog.y;
+    data[4] = occupancy->top;
+    int *values = data + 5;
+    for (int i = 0; i < cars->count; i++)
+    {
+        values[2 * i] = cars->x[i];
+        values[2 * i + 1] = cars->y[i];
+    }
+    values += 2 * cars->count;
+    for (int i = 0; i < obstacles; i++)
+    {
+        values[2 * i] = sim->obstacle[i].x;
+        values[2 * i + 1] = sim->obstacle[i].y;
+    }
+    values += 2 * obstacles;
+    for (int y = 0; y < occupancy->rows; y++)
+    {
+        values[y] = sim->used_flags[occupancy_slot(occupancy, occupancy->top + y)]; // wiersze w kolejnosci widoku
+    }
+}
+
+//Load a frame into a game built from the same config and seed, enough for the renderer to draw it
+void frame_decode(Simulation *sim, const int *data)
+{
+    Occupancy *occupancy = &sim->occupancy;
+    CarStore *cars = &sim->cars;
+    int obstacles = sim->config.number_of_obstacles;
+    sim->game_ticks = data[0];
+    sim->state = (SimState)data[1];
+    sim->frog.x = data[2];
+    sim->frog.y = data[3];
+    occupancy->top = data[4];
+    occupancy->base = 0; // flagi drog sa w kolejnosci widoku
+    const int *values = data + 5;
+    for (int i = 0; i < cars->count; i++)
+    {
+        cars->x[i] = values[2 * i];
+        cars->y[i] = values[2 * i + 1];
+    }
+    values += 2 * cars->count;
+    for (int i = 0; i < obstacles; i++)
+    {
+        sim->obstacle[i].x = values[2 * i];
+        sim->obstacle[i].y = values[2 * i + 1];
+    }
+    values += 2 * obstacles;
+    for (int y = 0; y < occupancy->rows; y++)
+    {
+        sim->used_flags[y] = values[y];
+    }
+}
+
+//Copy the state the renderer draws into the next slot; the cost does not depend on the number of spectators
+void spectator_publish(SpectatorRing *ring, Simulation *sim)
+{
+    uint64_t frame = ring->frame + 1;
+    atomic<uint64_t> *sequence = spectator_slot(ring, frame);
+
+    sequence->store(frame * 2 - 1, memory_order_relaxed); // widz, ktory trafi na zapis, odrzuci te klatke
+    atomic_thread_fence(memory_order_release);
+    frame_encode(sim, (int *)(sequence + 1));
+
+    sequence->store(frame * 2, memory_order_release);
+    ring->header->published.store(frame, memory_order_release);
+    ring->frame = frame;
+}
+
+//Tell spectators the game is over and unmap the file
+void spectator_close(SpectatorRing *ring)
+{
+    ring->header->closed.store(1, memory_order_release);
+    munmap(ring->header, ring->size);
+}
+
+//Map a published game read-only, config and seed rebuild the same board
+int spectator_open(SpectatorRing *ring, const char *file_name, GameConfig *config, uint64_t *seed)
+{
+    int fd = open(file_name, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        perror("Cannot open spectator file");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return 1;
+    }
+    ring->size = (size_t)info.st_size;
+    void *data = ring->size >= spectator_header_size() ? mmap(nullptr, ring->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Cannot map spectator file: %s\n", file_name);
+        return 1;
+    }
+
+    ring->header = (SpectatorHeader *)data;
+    SpectatorHeader *header = ring->header;
+    bool valid = memcmp(header->magic, "JFSP", 4) == 0 && header->version == SpectatorVersion;
+    atomic_thread_fence(memory_order_acquire);
+    if (!valid || header->frame_ints != spectator_frame_ints(&header->config) ||
+        ring->size < spectator_header_size() + (size_t)header->slot_size * SpectatorSlots)
+    {
+        fprintf(stderr, "Not a spectator file: %s\n", file_name);
+        munmap(data, ring->size);
+        return 1;
+    }
+
+    *config = header->config;
+    *seed = header->seed;
+    ring->frame = 0;
+    ring->copy = (int *)malloc(sizeof(int) * header->frame_ints);
+    if (ring->copy == nullptr)
+    {
+        perror("Cannot allocate spectator frame");
+        munmap(data, ring->size);
+        return 1;
+    }
+    return 0;
+}
+
+//Take the newest frame if it is consistent (seqlock), false when there is nothing new or the writer got in the way
+bool spectator_read(SpectatorRing *ring, Simulation *sim)
+{
+    uint64_t frame = ring->header->published.load(memory_order_acquire);
+    if (frame == ring->frame)
+    {
+        return false;
+    }
+    atomic<uint64_t> *sequence = spectator_slot(ring, frame);
+    uint64_t before = sequence->load(memory_order_acquire);
+    if (before != frame * 2)
+    {
+        return false; // miejsce juz nadpisywane, w nastepnym obrocie bedzie nowsza klatka
+    }
+    memcpy(ring->copy, sequence + 1, sizeof(int) * ring->header->frame_ints);
+    atomic_thread_fence(memory_order_acquire);
+    if (sequence->load(memory_order_relaxed) != before)
+    {
+        return false;
+    }
+
+    frame_decode(sim, ring->copy);
+    ring->frame = frame;
+    return true;
+}
+
+void spectator_free(SpectatorRing *ring)
+{
+    free(ring->copy);
+    munmap(ring->header, ring->size);
+}
+
+
+//Gameplay functions
+
+//Current time in microseconds on a monotonic clock
+long long monotonic_usec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+void clock_init(GameClock *game_clock, double scale)
+{
+    game_clock->real_last = monotonic_usec();
+    game_clock->accumulator = 0;
+    game_clock->scale = scale;
+}
+
+//Move virtual time by the real time that passed, returns how many ticks are due now
+int clock_advance(GameClock *game_clock)
+{
+    long long now = monotonic_usec();
+    game_clock->accumulator += (now - game_clock->real_last) * game_clock->scale;
+    game_clock->real_last = now;
+
+    int ticks = 0;
+    while (ticks < ClockMaxCatchUp && game_clock->accumulator >= FrameDelay) // zaleglosci nie przepadaja, najwyzej czekaja na kolejny obrot
+    {
+        game_clock->accumulator -= FrameDelay;
+        ticks++;
+    }
+    return ticks;
+}
+
+//Real time (monotonic_usec) at which the next tick becomes due
+long long clock_next_tick(GameClock *game_clock)
+{
+    double left = FrameDelay - game_clock->accumulator;
+    return left > 0 ? game_clock->real_last + (long long)(left / game_clock->scale) + 1 : game_clock->real_last;
+}
+
+//Sleep until one of the descriptors becomes readable or the timeout runs out
+bool wait_for_fds(struct pollfd *fds, int count, long long timeout_usec)
+{
+    struct timespec timeout;
+    timeout.tv_sec = timeout_usec / 1000000; // czas do najblizszego zdarzenia
+    timeout.tv_nsec = (timeout_usec % 1000000) * 1000;
+
+    return ppoll(fds, count, &timeout, nullptr) > 0; // watek spi az do klawisza albo timera
+}
+
+//Sleep until stdin becomes readable or the timeout runs out
+bool wait_for_input(long long timeout_usec)
+{
+    struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+    return wait_for_fds(&input, 1, timeout_usec);
+}
+
+//Keys that make the frog jump and therefore wait for the cooldown
+bool input_is_move(int key)
+{
+    return key == KEY_UP || key == KEY_DOWN || key == KEY_LEFT || key == KEY_RIGHT;
+}
+
+//Queue a key; a move right behind a move that is still waiting replaces it, so key repeat never piles up
+void input_push(InputQueue *queue, int key, long long time)
+{
+    if (queue->count > 0 && input_is_move(key))
+    {
+        InputEvent *last = &queue->events[(queue->head + queue->count - 1) % InputQueueSize];
+        if (input_is_move(last->key))
+        {
+            last->key = key; // wygrywa najnowszy kierunek
+            last->time = time;
+            queue->coalesced++;
+            return;
+        }
+    }
+    if (queue->count == InputQueueSize)
+    {
+        queue->dropped++;
+        return;
+    }
+    InputEvent *event = &queue->events[(queue->head + queue->count) % InputQueueSize];
+    event->key = key;
+    event->time = time;
+    queue->count++;
+}
+
+//Apply queued keys in order until a move has to wait for the end of the previous jump
+void input_apply(InputQueue *queue, Simulation *sim, FrameStats *stats)
+{
+    while (queue->count > 0 && sim->state == SimRunning)
+    {
+        InputEvent *event = &queue->events[queue->head];
+        if (input_is_move(event->key) && sim->game_ticks - sim->last_jump_tick < JumpDelayTicks)
+        {
+            return; // sprobujemy po nastepnym ticku
+        }
+
+        simulation_input(sim, event->key);
+        if (stats != nullptr && input_is_move(event->key))
+        {
+            histogram_record(&stats->phase[PhaseMove], monotonic_nsec() - event->time);
+        }
+        queue->head = (queue->head + 1) % InputQueueSize;
+        queue->count--;
+    }
+    if (sim->state != SimRunning)
+    {
+        queue->count = 0; // po koncu gry nie ma czego wykonywac
+    }
+}
+
+//Read every pending key into the queue and apply what can be applied now, true when the player quits
+bool process_user_input(WINDOW *board_win, Simulation *sim, InputQueue *queue, FrameStats *stats)
+{
+    int move_input; //przetrzymuje znak wprowadzony przez uzytkownika w oknie board_win
+    long long now = monotonic_nsec(); // wszystkie klawisze z jednego przebudzenia przyszly najpozniej teraz
+
+    while ((move_input = wgetch(board_win)) != ERR) // czytamy wszystkie oczekujace klawisze
+    {
+        //End game
+        if (move_input == 'o')
+        {
+            return true;
+        }
+
+        input_push(queue, move_input, now);
+        input_apply(queue, sim, stats); // pierwszy ruch od razu, dopiero kolejne czekaja i sie lacza
+    }
+    return false;
+}
+
+bool refresh_screen(WINDOW *board_win, Renderer *renderer, Simulation *sim)
+{
+    GameConfig config = sim->config;
+    FrameStats *stats = renderer->stats;
+
+    if (renderer->spectators != nullptr) // ten sam stan, ktory zaraz jest rysowany
+    {
+        spectator_publish(renderer->spectators, sim);
+    }
+
+    //Only the board elements that changed
+    long long draw_start = stats_start(stats);
+    draw_changed_cells(board_win, renderer, sim);
+
+    int elapsed_time = game_seconds(sim); // czas gry w sekundach liczony z tickow zegara wirtualnego
+    if (elapsed_time != renderer->drawn_time) // tekst czasu tylko gdy sie zmienil
+    {
+        display_info(board_win, renderer, elapsed_time, config.endless ? endless_distance(sim) : -1, config); // wyswietlenie tej informacji
+        if (stats != nullptr && stats->overlay)
+        {
+            display_stats(board_win, renderer, stats); // raz na sekunde razem z czasem
+        }
+        if (renderer->ansi == nullptr)
+        {
+            wnoutrefresh(stdscr); // w ANSI tekst jest w tym samym buforze co plansza
+        }
+        renderer->drawn_time = elapsed_time;
+    }
+    stats_stop(stats, PhaseDraw, draw_start);
+
+    if (sim->state == SimLost)
+    {
+        delete_frog(board_win, renderer, &sim->frog); //usuwaj zabe
+        display_lose_message(board_win, renderer); // wyswietl komunikat o przegranej, razem z usunieta zaba
+        return true;
+    }
+
+    if (sim->state == SimWon) // czy zaba doszla do mety
+    {
+        display_win_message(board_win, renderer, elapsed_time, config); // wyswietl win info
+        return true;
+    }
+
+    long long output_start = stats_start(stats);
+    present_frame(board_win, renderer);
+    stats_stop(stats, PhaseOutput, output_start);
+
+    if (stats != nullptr && stats->pending_input != 0) // klawisz jest juz widoczny
+    {
+        stats_stop(stats, PhaseLatency, stats->pending_input);
+        stats->pending_input = 0;
+    }
+    return false;
+}
+
+WINDOW *initialize_ncurses(GameConfig config)
+{
+    initscr(); //wlacza biblioteke ncurses
+    curs_set(FALSE); //ukrycie kursora
+    noecho(); //ukrycie wprowadzanych danych
+    initialize_colors(); //ustawienie kolorow
+
+    //Create board
+    WINDOW *board_win = create_board(config.playing_area_height, config.playing_area_width);
+    if (board_win == nullptr) // jak sie nie uda to konczymy ncurses
+    {
+        endwin();
+    }
+    keypad(board_win, TRUE); // wlacza obsluge klawiatury w oknie boardwin
+    keypad(stdscr, TRUE); // wlacza obsluge klawiatury w glownym oknie
+
+    return board_win; // zwraca wskaznik okna do wyswietlenia
+}
+
+void draw_initial_state(WINDOW *board_win, Renderer *renderer, Simulation *sim)
+{
+    if (renderer->ansi != nullptr)
+    {
+        ansi_clear(renderer->ansi); // pierwsza klatka przemaluje caly terminal
+    }
+    else
+    {
+        wclear(board_win); // zamyka wszystko co bylo dotychczas w oknie
+    }
+
+    frogger_text(board_win, renderer);
+    draw_full_frame(board_win, renderer, sim);
+
+    if (renderer->ansi != nullptr)
+    {
+        present_frame(board_win, renderer);
+        return;
+    }
+    refresh(); // napis FROGGER na stdscr
+    wrefresh(board_win); //odswierzenie okna board_win wraz z jego wszystkimi zmianami
+}
+
+//Feed all keys recorded for the current tick, false once the recording has ended
+bool replay_inputs(Simulation *sim, ReplayReader *reader)
+{
+    while (reader->next_code != ReplayEnd && reader->next_tick == sim->game_ticks)
+    {
+        simulation_input(sim, code_to_key(reader->next_code));
+        if (!replay_next(reader))
+        {
+            reader->next_code = ReplayEnd; // uciety plik, konczymy na tym co jest
+            reader->end_tick = sim->game_ticks;
+        }
+    }
+    return sim->state == SimRunning && !(reader->next_code == ReplayEnd && sim->game_ticks >= reader->end_tick);
+}
+
+//Game loop: input whenever it arrives, ticks on the virtual clock, redraws at most every RefreshDelay.
+//With a reader the keys come from the recording and the keyboard only stops the game with 'o'
+void gameplay(WINDOW *board_win, Renderer *renderer, Simulation *sim, ReplayReader *reader, double scale)
+{
+    nodelay(board_win, TRUE); // ustawiamy okno tak ze nie czeka na wejscie uzytkownika
+
+    GameClock game_clock;
+    clock_init(&game_clock, scale);
+    long long last_refresh = game_clock.real_last - RefreshDelay; // czas ostatniego odswiezenia ekranu
+    bool dirty = true; // czy od ostatniego odswiezenia cos sie zmienilo
+    bool replay_done = false; // zapis sie skonczyl przed rozstrzygnieciem gry
+
+    FrameStats *stats = renderer->stats;
+    InputQueue queue = {};
+
+    while (true)
+    {
+        //Sleep until the nearest deadline: next tick, or next allowed refresh if something changed
+        long long deadline = clock_next_tick(&game_clock);
+        if (dirty && last_refresh + RefreshDelay < deadline)
+        {
+            deadline = last_refresh + RefreshDelay;
+        }
+
+        long long now = monotonic_usec();
+        bool woken = deadline > now && wait_for_input(deadline - now);
+        long long frame_start = stats_start(stats); // od przebudzenia do wyslania ekranu
+        if (woken)
+        {
+            if (stats != nullptr && stats->pending_input == 0 && reader == nullptr)
+            {
+                stats->pending_input = frame_start;
+            }
+            bool quit = reader != nullptr ? wgetch(board_win) == 'o' : process_user_input(board_win, sim, &queue, stats); // sprawdza czy uzytkownik zakonczyl gre
+            stats_stop(stats, PhaseInput, frame_start);
+            if (quit)
+            {
+                break;
+            }
+            dirty = true;
+        }
+
+        //Every tick the clock owes, the screen is drawn once after all of them
+        int ticks = clock_advance(&game_clock);
+        for (int i = 0; i < ticks && sim->state == SimRunning; i++)
+        {
+            if (reader != nullptr && !replay_inputs(sim, reader))
+            {
+                replay_done = true;
+                break;
+            }
+            long long tick_start = stats_start(stats);
+            simulation_tick(sim);
+            input_apply(&queue, sim, stats); // ruch czekajacy na koniec skoku w pierwszym mozliwym ticku
+            stats_stop(stats, PhaseTick, tick_start);
+            dirty = true;
+        }
+
+        now = monotonic_usec();
+        if (replay_done || (dirty && now - last_refresh >= RefreshDelay))
+        {
+            if (refresh_screen(board_win, renderer, sim) || replay_done) // odswierzenie ekranu, sprawdzenie czy gra powinna zostac zakonczona
+            {
+                break; // jesli gra zakonczona, wychodzimy z petli
+            }
+            last_refresh = now;
+            dirty = false;
+        }
+        stats_stop(stats, PhaseFrame, frame_start);
+    }
+    if (stats != nullptr)
+    {
+        stats->coalesced_moves = queue.coalesced;
+        stats->dropped_keys = queue.dropped;
+    }
+}
+
+//THREADED FUNCTIONS
+
+bool triple_init(TripleBuffer *buffer, int frame_ints)
+{
+    buffer->frames = (int *)calloc((size_t)frame_ints * 3, sizeof(int));
+    buffer->frame_ints = frame_ints;
+    buffer->back = 0;
+    buffer->middle.store(1, memory_order_relaxed);
+    buffer->front = 2;
+    return buffer->frames != nullptr;
+}
+
+//Fill the back frame and swap it with the middle one, the frame the reader holds is never touched
+void triple_publish(TripleBuffer *buffer, Simulation *sim)
+{
+    frame_encode(sim, buffer->frames + (size_t)buffer->back * buffer->frame_ints);
+    buffer->back = buffer->middle.exchange(buffer->back | TripleFresh, memory_order_acq_rel) & 3;
+}
+
+//Take the newest frame into the render copy of the game, false when nothing was published since the last one
+bool triple_take(TripleBuffer *buffer, Simulation *sim)
+{
+    if ((buffer->middle.load(memory_order_relaxed) & TripleFresh) == 0)
+    {
+        return false;
+    }
+    buffer->front = buffer->middle.exchange(buffer->front, memory_order_acq_rel) & 3;
+    frame_decode(sim, buffer->frames + (size_t)buffer->front * buffer->frame_ints);
+    return true;
+}
+
+bool key_ring_push(KeyRing *ring, int key, long long time)
+{
+    uint32_t head = ring->head.load(memory_order_relaxed);
+    if (head - ring->tail.load(memory_order_acquire) == InputQueueSize)
+    {
+        ring->dropped++;
+        return false;
+    }
+    ring->events[head % InputQueueSize] = {key, time};
+    ring->head.store(head + 1, memory_order_release);
+    return true;
+}
+
+bool key_ring_pop(KeyRing *ring, InputEvent *event)
+{
+    uint32_t tail = ring->tail.load(memory_order_relaxed);
+    if (tail == ring->head.load(memory_order_acquire))
+    {
+        return false;
+    }
+    *event = ring->events[tail % InputQueueSize];
+    ring->tail.store(tail + 1, memory_order_release);
+    return true;
+}
+
+//Wake the other thread through its pipe; a full pipe means it is going to wake anyway
+void thread_wake(int fd)
+{
+    if (write(fd, "", 1) < 0 && errno != EAGAIN)
+    {
+        perror("Cannot wake thread");
+    }
+}
+
+void thread_drain(int fd)
+{
+    char bytes[64];
+    while (read(fd, bytes, sizeof(bytes)) > 0)
+    {
+    }
+}
+
+//Simulation thread: ticks on the virtual clock and keys as soon as they arrive, however slow the terminal is
+void simulation_thread(SimThread *self)
+{
+    Simulation *sim = self->sim;
+    FrameStats *stats = self->measure ? &self->stats : nullptr;
+    GameClock game_clock;
+    clock_init(&game_clock, self->scale);
+    triple_publish(&self->frames, sim);
+    thread_wake(self->published[1]);
+
+    bool replay_done = false;
+    while (!self->quit.load(memory_order_acquire) && sim->state == SimRunning && !replay_done)
+    {
+        long long now = monotonic_usec(), deadline = clock_next_tick(&game_clock);
+        struct pollfd wake = {self->wake[0], POLLIN, 0};
+        if (deadline > now && wait_for_fds(&wake, 1, deadline - now))
+        {
+            thread_drain(self->wake[0]);
+        }
+
+        bool changed = false;
+        InputEvent event;
+        while (key_ring_pop(&self->keys, &event))
+        {
+            input_push(&self->queue, event.key, event.time);
+            input_apply(&self->queue, sim, stats); // pierwszy ruch od razu, jak w gameplay
+            changed = true;
+        }
+
+        int ticks = clock_advance(&game_clock);
+        for (int i = 0; i < ticks && sim->state == SimRunning; i++)
+        {
+            if (self->reader != nullptr && !replay_inputs(sim, self->reader))
+            {
+                replay_done = true;
+                break;
+            }
+            long long tick_start = stats_start(stats);
+            simulation_tick(sim);
+            input_apply(&self->queue, sim, stats);
+            stats_stop(stats, PhaseTick, tick_start);
+            changed = true;
+        }
+
+        if (changed)
+        {
+            triple_publish(&self->frames, sim);
+            thread_wake(self->published[1]);
+        }
+    }
+    triple_publish(&self->frames, sim); // stan koncowy, takze gdy gra skonczyla sie na klawiszu z zapisu
+    self->finished.store(true, memory_order_release);
+    thread_wake(self->published[1]);
+}
+
+//Add the histograms of the simulation thread to the ones of the render thread
+void stats_merge(FrameStats *into, FrameStats *from)
+{
+    for (int p = 0; p < Phases; p++)
+    {
+        Histogram *a = &into->phase[p], *b = &from->phase[p];
+        for (int k = 0; k < HistogramBuckets; k++)
+        {
+            a->counts[k] += b->counts[k];
+        }
+        a->count += b->count;
+        a->total += b->total;
+        a->max = b->max > a->max ? b->max : a->max;
+    }
+}
+
+//Close the pipes that were opened and free the frames, on every way out of gameplay_threaded
+void sim_thread_free(SimThread *self)
+{
+    int fds[] = {self->wake[0], self->wake[1], self->published[0], self->published[1]};
+    for (int fd : fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    free(self->frames.frames);
+    free(self);
+}
+
+//Game loop of --threaded: this thread reads the keyboard and draws the newest frame at most every RefreshDelay,
+//the game itself runs in simulation_thread. False when the threads could not be set up
+bool gameplay_threaded(WINDOW *board_win, Renderer *renderer, Simulation *sim, ReplayReader *reader, double scale)
+{
+    SimThread *self = (SimThread *)calloc(1, sizeof(SimThread));
+    Simulation view; // kopia do rysowania, zmieniana tylko przez triple_take
+    if (self == nullptr || !triple_init(&self->frames, spectator_frame_ints(&sim->config)))
+    {
+        perror("Cannot allocate frames");
+        free(self);
+        return false;
+    }
+    self->wake[0] = self->wake[1] = self->published[0] = self->published[1] = -1; // nieotwarte, sim_thread_free ich nie zamyka
+    if (pipe2(self->wake, O_NONBLOCK | O_CLOEXEC) != 0 || pipe2(self->published, O_NONBLOCK | O_CLOEXEC) != 0 ||
+        simulation_init(&view, sim->config, sim->seed) != 0)
+    {
+        perror("Cannot start simulation thread");
+        sim_thread_free(self);
+        return false;
+    }
+    self->sim = sim;
+    self->reader = reader;
+    self->scale = scale;
+    self->measure = renderer->stats != nullptr;
+    nodelay(board_win, TRUE);
+
+    FrameStats *stats = renderer->stats;
+    thread simulation(simulation_thread, self);
+    long long last_refresh = monotonic_usec() - RefreshDelay;
+    bool waiting = false; // jest nowa klatka, ale jeszcze za wczesnie na odswiezenie
+    while (true)
+    {
+        long long now = monotonic_usec();
+        long long timeout = waiting ? last_refresh + RefreshDelay - now : FrameDelay * 10; // bez klatek i klawiszy budzi nas pipe
+        struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {self->published[0], POLLIN, 0}};
+        wait_for_fds(fds, 2, timeout > 0 ? timeout : 0);
+        long long frame_start = stats_start(stats);
+
+        //Keys go to the simulation thread, only 'o' is handled here
+        bool quit = false;
+        int key;
+        while (!quit && (key = wgetch(board_win)) != ERR)
+        {
+            quit = key == 'o';
+            if (!quit && reader == nullptr && key_ring_push(&self->keys, key, monotonic_nsec()))
+            {
+                if (stats != nullptr && stats->pending_input == 0)
+                {
+                    stats->pending_input = frame_start;
+                }
+                thread_wake(self->wake[1]);
+            }
+        }
+        stats_stop(stats, PhaseInput, frame_start);
+        if (quit)
+        {
+            break;
+        }
+
+        //Newest frame, older ones the terminal did not keep up with are skipped
+        thread_drain(self->published[0]);
+        bool finished = self->finished.load(memory_order_acquire);
+        now = monotonic_usec();
+        if (!finished && now - last_refresh < RefreshDelay)
+        {
+            waiting = true;
+            continue;
+        }
+        bool fresh = triple_take(&self->frames, &view);
+        if (fresh && (refresh_screen(board_win, renderer, &view) || finished))
+        {
+            break; // koniec gry z komunikatem, albo koniec zapisu
+        }
+        if (fresh)
+        {
+            last_refresh = now;
+            stats_stop(stats, PhaseFrame, frame_start);
+        }
+        else if (finished)
+        {
+            break;
+        }
+        waiting = false;
+    }
+
+    self->quit.store(true, memory_order_release);
+    thread_wake(self->wake[1]);
+    simulation.join();
+    if (stats != nullptr)
+    {
+        stats_merge(stats, &self->stats);
+        stats->coalesced_moves = self->queue.coalesced;
+        stats->dropped_keys = self->queue.dropped + self->keys.dropped;
+    }
+    simulation_free(&view);
+    sim_thread_free(self);
+    return true;
+}
+
+//Watch a game published by another process: the same renderer, fed from the shared frames
+int run_spectator(const char *file_name)
+{
+    SpectatorRing ring;
+    GameConfig config;
+    uint64_t seed;
+    if (spectator_open(&ring, file_name, &config, &seed) != 0)
+    {
+        return 1;
+    }
+    Simulation sim;
+    if (validate_config(&config) != 0 || simulation_init(&sim, config, seed) != 0)
+    {
+        spectator_free(&ring);
+        return 1;
+    }
+    spectator_read(&ring, &sim); // gra mogla juz trwac
+
+    WINDOW *board_win = initialize_ncurses(config);
+    Renderer renderer;
+    if (board_win == nullptr || renderer_init(&renderer, &sim) != 0)
+    {
+        endwin();
+        simulation_free(&sim);
+        spectator_free(&ring);
+        return 1;
+    }
+    nodelay(board_win, TRUE);
+    draw_initial_state(board_win, &renderer, &sim);
+
+    while (wgetch(board_win) != 'o')
+    {
+        if (spectator_read(&ring, &sim))
+        {
+            if (refresh_screen(board_win, &renderer, &sim)) // koniec gry, z komunikatem jak u gracza
+            {
+                break;
+            }
+        }
+        else if (ring.header->closed.load(memory_order_acquire) && ring.header->published.load(memory_order_acquire) == ring.frame)
+        {
+            break; // wydawca skonczyl bez rozstrzygniecia
+        }
+        wait_for_input(RefreshDelay);
+    }
+
+    delwin(board_win);
+    endwin();
+    renderer_free(&renderer);
+    simulation_free(&sim);
+    spectator_free(&ring);
+    return 0;
+}
+
+//REPLAY FUNCTIONS
+
+const char *state_name(int state)
+{
+    return state == SimWon ? "won" : state == SimLost ? "lost" : "running";
+}
+
+//Re-simulate a recording as fast as possible and check its outcome
+int run_replay_headless(Simulation *sim, ReplayReader *reader)
+{
+    long long start = monotonic_usec();
+    while (replay_inputs(sim, reader))
+    {
+        simulation_tick(sim);
+    }
+    double seconds = (monotonic_usec() - start) / 1000000.0;
+
+    bool match = !reader->corrupt && sim->state == reader->outcome && sim->game_ticks == reader->end_tick;
+    printf("seed: %llu\n", (unsigned long long)sim->seed);
+    printf("replayed: %s at tick %d\n", state_name(sim->state), sim->game_ticks);
+    printf("expected: %s at tick %d\n", state_name(reader->outcome), reader->end_tick);
+    if (sim->config.endless)
+    {
+        printf("distance: %d rows\n", endless_distance(sim));
+    }
+    printf("time: %.3f s (%.0fx real time)\n", seconds,
+           seconds > 0 ? (double)sim->game_ticks * FrameDelay / 1000000.0 / seconds : 0.0);
+    printf("%s\n", reader->corrupt ? "RECORDING CORRUPT" : match ? "outcome reproduced" : "OUTCOME MISMATCH");
+    return match ? 0 : 1;
+}
+
+
+//SOLVER FUNCTIONS
+
+bool heap_push(Heap *heap, uint64_t key, int value)
+{
+    if (heap->size == heap->capacity)
+    {
+        int capacity = heap->capacity ? heap->capacity * 2 : 1024;
+        uint64_t *keys = (uint64_t *)realloc(heap->keys, sizeof(uint64_t) * capacity);
+        int *values = keys ? (int *)realloc(heap->values, sizeof(int) * capacity) : nullptr;
+        if (keys != nullptr)
+        {
+            heap->keys = keys;
+        }
+        if (values == nullptr)
+        {
+            return false;
+        }
+        heap->values = values;
+        heap->capacity = capacity;
+    }
+
+    int i = heap->size++;
+    while (i > 0 && heap->keys[(i - 1) / 2] > key) // przesuwamy rodzicow w dol
+    {
+        heap->keys[i] = heap->keys[(i - 1) / 2];
+        heap->values[i] = heap->values[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->keys[i] = key;
+    heap->values[i] = value;
+    return true;
+}
+
+void heap_pop(Heap *heap, uint64_t *key, int *value)
+{
+    *key = heap->keys[0];
+    *value = heap->values[0];
+
+    uint64_t last_key = heap->keys[--heap->size];
+    int last_value = heap->values[heap->size];
+    int i = 0;
+    while (2 * i + 1 < heap->size) // ostatni element zsuwamy od korzenia
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < heap->size && heap->keys[child + 1] < heap->keys[child])
+        {
+            child++;
+        }
+        if (heap->keys[child] >= last_key)
+        {
+            break;
+        }
+        heap->keys[i] = heap->keys[child];
+        heap->values[i] = heap->values[child];
+        i = child;
+    }
+    heap->keys[i] = last_key;
+    heap->values[i] = last_value;
+}
+
+void heap_free(Heap *heap)
+{
+    free(heap->keys);
+    free(heap->values);
+}
+
+//Ticks in [0, tick) on which a car with this speed moves (move_hostile_cars moves it when tick % speed == 0)
+int moving_ticks(int tick, int speed)
+{
+    return (tick + speed - 1) / speed;
+}
+
+//Phase of the bounce cycle of a car at x going in direction
+int forecast_phase(Forecast *forecast, int x, int direction)
+{
+    return direction > 0 ? x - 1 : (forecast->cycle - (x - 1)) % forecast->cycle;
+}
+
+//Left wheel of a car in this phase: right from x = 1 in the first half of the cycle, back in the second
+int forecast_phase_x(Forecast *forecast, int phase)
+{
+    int half = forecast->cycle / 2;
+    return 1 + (phase <= half ? phase : forecast->cycle - phase);
+}
+
+//Schedule the next bounce of a lane: a car draws its random numbers on the move out of phase 0 or the half cycle
+bool forecast_schedule(Forecast *forecast, int lane, int tick, int phase, int speed)
+{
+    int half = forecast->cycle / 2;
+    int moves = phase == 0 || phase == half ? 0 : phase < half ? half - phase : forecast->cycle - phase;
+    long long bounce = (long long)(moving_ticks(tick, speed) + moves) * speed;
+    if (bounce >= INT32_MAX)
+    {
+        return true; // poza horyzontem przeszukiwania
+    }
+    return heap_push(&forecast->events, (uint64_t)bounce << 32 | (uint32_t)lane, 0);
+}
+
+//Start a new period of a lane, the forecast of the lane from that tick on changes
+bool forecast_add(Forecast *forecast, int lane, LanePeriod period)
+{
+    if (forecast->count[lane] == forecast->capacity[lane])
+    {
+        int capacity = forecast->capacity[lane] ? forecast->capacity[lane] * 2 : 4;
+        LanePeriod *periods = (LanePeriod *)realloc(forecast->periods[lane], sizeof(LanePeriod) * capacity);
+        if (periods == nullptr)
+        {
+            return false;
+        }
+        forecast->periods[lane] = periods;
+        forecast->capacity[lane] = capacity;
+    }
+    forecast->periods[lane][forecast->count[lane]++] = period;
+    return true;
+}
+
+//Allocate the forecast for the boards of this game and build the row masks of one cycle
+bool forecast_init(Forecast *forecast, Simulation *sim)
+{
+    int n = sim->cars.begin[CarHostile + 1] - sim->cars.begin[CarHostile];
+    memset(forecast, 0, sizeof(Forecast));
+    forecast->cars = n;
+    forecast->rows = sim->config.playing_area_height;
+    forecast->cols = sim->config.playing_area_width;
+    forecast->cycle = 2 * (forecast->cols - 5); // x od 1 do cols - 4 i z powrotem
+    forecast->words = (forecast->cols + 63) / 64;
+    forecast->masks = (uint64_t *)calloc((size_t)forecast->cycle * forecast->words, sizeof(uint64_t));
+    forecast->periods = (LanePeriod **)calloc(n + 1, sizeof(LanePeriod *));
+    forecast->count = (int *)calloc((size_t)(n + 1) * 6 + forecast->rows, sizeof(int));
+    if (forecast->masks == nullptr || forecast->periods == nullptr || forecast->count == nullptr)
+    {
+        return false;
+    }
+    forecast->capacity = forecast->count + n + 1;
+    forecast->cursor = forecast->capacity + n + 1;
+    forecast->batch = forecast->cursor + n + 1;
+    forecast->roll = forecast->batch + n + 1;
+    forecast->new_speed = forecast->roll + n + 1;
+    forecast->row_lane = forecast->new_speed + n + 1;
+
+    for (int phase = 0; phase < forecast->cycle; phase++)
+    {
+        uint64_t *mask = forecast->masks + (size_t)phase * forecast->words;
+        int x = forecast_phase_x(forecast, phase);
+        mask[x / 64] |= 1ULL << (x % 64);
+        mask[(x + 2) / 64] |= 1ULL << ((x + 2) % 64);
+    }
+    return true;
+}
+
+//Forget the old game and forecast the hostile cars of the game as they are now
+bool forecast_start(Forecast *forecast, Simulation *sim)
+{
+    CarStore *cars = &sim->cars;
+    forecast->rng = sim->hostile_rng;
+    forecast->events.size = 0;
+    forecast->changes = 0;
+    for (int y = 0; y < forecast->rows; y++)
+    {
+        forecast->row_lane[y] = -1;
+    }
+    for (int k = 0; k < forecast->cars; k++)
+    {
+        int i = cars->begin[CarHostile] + k;
+        LanePeriod period = {sim->game_ticks, forecast_phase(forecast, cars->x[i], cars->direction[i]), cars->speed[i]};
+        forecast->count[k] = 0;
+        forecast->cursor[k] = 0;
+        forecast->row_lane[cars->y[i]] = k;
+        if (!forecast_add(forecast, k, period) || !forecast_schedule(forecast, k, period.tick, period.phase, period.speed))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void forecast_free(Forecast *forecast)
+{
+    for (int k = 0; k < forecast->cars; k++)
+    {
+        free(forecast->periods[k]);
+    }
+    free(forecast->periods);
+    free(forecast->count);
+    free(forecast->masks);
+    heap_free(&forecast->events);
+}
+
+//Replay bounces up to the given tick in the same order and with the same random draws as move_hostile_cars
+bool forecast_extend(Forecast *forecast, int tick)
+{
+    while (forecast->events.size > 0 && (int)(forecast->events.keys[0] >> 32) < tick)
+    {
+        int bounce_tick = (int)(forecast->events.keys[0] >> 32), count = 0;
+        while (forecast->events.size > 0 && (int)(forecast->events.keys[0] >> 32) == bounce_tick) // indeksy rosnaco, jak w kernelu
+        {
+            uint64_t key;
+            int unused;
+            heap_pop(&forecast->events, &key, &unused);
+            forecast->batch[count++] = (int)(key & 0xFFFFFFFFULL);
+        }
+
+        fill_random(&forecast->rng, forecast->roll, count, 1, 4);
+        fill_random(&forecast->rng, forecast->new_speed, count, 1, 3);
+        for (int b = 0; b < count; b++)
+        {
+            int lane = forecast->batch[b];
+            LanePeriod last = forecast->periods[lane][forecast->count[lane] - 1];
+            int moves = moving_ticks(bounce_tick, last.speed) - moving_ticks(last.tick, last.speed);
+            int phase = (last.phase + moves + 1) % forecast->cycle; // faza po ruchu odbicia
+            int speed = forecast->roll[b] == 1 ? forecast->new_speed[b] : last.speed;
+            if (speed != last.speed) // ta sama predkosc - okres pasa dalej wazny
+            {
+                LanePeriod next = {bounce_tick + 1, phase, speed};
+                forecast->changes++;
+                if (!forecast_add(forecast, lane, next))
+                {
+                    return false;
+                }
+            }
+            if (!forecast_schedule(forecast, lane, bounce_tick + 1, phase, speed))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//Row mask of a lane at the given tick (the forecast must be extended up to it)
+const uint64_t *forecast_mask(Forecast *forecast, int lane, int tick)
+{
+    LanePeriod *periods = forecast->periods[lane];
+    int last = forecast->count[lane] - 1, k = forecast->cursor[lane];
+    if (periods[k].tick > tick || (k < last && periods[k + 1].tick <= tick)) // poza okresem z poprzedniego zapytania
+    {
+        int low = 0, high = last;
+        while (low < high) // ostatni okres zaczety nie pozniej niz tick
+        {
+            int middle = (low + high + 1) / 2;
+            if (periods[middle].tick <= tick)
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle - 1;
+            }
+        }
+        k = forecast->cursor[lane] = low;
+    }
+    LanePeriod *period = &periods[k];
+    int phase = (period->phase + moving_ticks(tick, period->speed) - moving_ticks(period->tick, period->speed)) % forecast->cycle;
+    return forecast->masks + (size_t)phase * forecast->words;
+}
+
+//Is cell (x, y) under a wheel of a hostile car at the given tick
+bool forecast_hit(Forecast *forecast, int y, int x, int tick)
+{
+    int lane = y >= 0 && y < forecast->rows ? forecast->row_lane[y] : -1;
+    if (lane < 0 || x < 0 || x >= forecast->cols)
+    {
+        return false;
+    }
+    return (forecast_mask(forecast, lane, tick)[x / 64] >> (x % 64)) & 1;
+}
+
+//Would the frog at x, y be hit at any tick from tick to tick + ticks
+bool forecast_danger(Forecast *forecast, int x, int y, int tick, int ticks)
+{
+    for (int t = tick; t <= tick + ticks; t++)
+    {
+        if (forecast_hit(forecast, y, x, t) || forecast_hit(forecast, y + 1, x, t))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Would the frog at x, y be hit by a hostile car at this tick
+bool solver_hit(Forecast *forecast, int x, int y, int tick)
+{
+    return forecast_hit(forecast, y, x, tick) || forecast_hit(forecast, y + 1, x, tick);
+}
+
+//Fewest ticks from this node to the finish: one jump per JumpDelayTicks
+int solver_estimate(SolverNode *node, Finish *finish)
+{
+    int moves = abs(node->x - finish->x) + abs(node->y - finish->y);
+    int wait = JumpDelayTicks - node->since_jump;
+    return (wait > 0 ? wait : 0) + (moves - 1) * JumpDelayTicks;
+}
+
+//Entries are (state + 1) << 3 | ticks since jump; a state is only worth visiting again when ready sooner
+static_assert(JumpDelayTicks < 8, "ticks since jump must fit in 3 bits of a StateSet entry");
+
+bool state_set_put(uint64_t *keys, size_t mask, uint64_t entry)
+{
+    uint64_t key = entry >> 3;
+    size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 20) & mask;
+    while (keys[i] != 0)
+    {
+        if (keys[i] >> 3 == key)
+        {
+            if ((keys[i] & 7) >= (entry & 7))
+            {
+                return false; // ten sam stan, nie pozniej gotowy do skoku
+            }
+            keys[i] = entry;
+            return true;
+        }
+        i = (i + 1) & mask;
+    }
+    keys[i] = entry;
+    return true;
+}
+
+//Insert a state, false if it was already there at least as ready; the table doubles at half load
+bool state_set_insert(StateSet *set, uint64_t state, int since_jump, bool *failed)
+{
+    if (set->count * 2 >= set->mask)
+    {
+        size_t mask = set->mask ? set->mask * 2 + 1 : 4095;
+        uint64_t *keys = (uint64_t *)calloc(mask + 1, sizeof(uint64_t));
+        if (keys == nullptr)
+        {
+            *failed = true;
+            return false;
+        }
+        for (size_t i = 0; set->keys != nullptr && i <= set->mask; i++)
+        {
+            if (set->keys[i] != 0)
+            {
+                state_set_put(keys, mask, set->keys[i]);
+            }
+        }
+        free(set->keys);
+        set->keys = keys;
+        set->mask = mask;
+    }
+
+    bool added = state_set_put(set->keys, set->mask, (state + 1) << 3 | (uint64_t)since_jump);
+    set->count += added;
+    return added;
+}
+
+//A* over (x, y, tick, ticks since jump) from the current game state to the finish.
+//Only hostile cars can end the game and their paths do not depend on the frog,
+//so they are computed once and shared by all states. Friendly pushes are never used:
+//a push moves the frog one cell sideways, which a jump does as well.
+//Returns the tick on which the frog reaches the finish, or -1 (also when more than
+//about max_nodes states would be needed). Keys go to plan if given.
+int solve_level(Simulation *sim, Recording *plan, long *expanded, int max_nodes)
+{
+    Forecast forecast;
+    Heap open = {nullptr, nullptr, 0, 0};
+    StateSet closed = {nullptr, 0, 0};
+    int node_capacity = 1024;
+    SolverNode *nodes = (SolverNode *)malloc(sizeof(SolverNode) * node_capacity);
+    bool ready = forecast_init(&forecast, sim) && forecast_start(&forecast, sim) && nodes != nullptr;
+    bool failed = false;
+
+    int rows = sim->config.playing_area_height, cols = sim->config.playing_area_width;
+    int since_jump = sim->game_ticks - sim->last_jump_tick;
+    int node_count = 1, goal = -1, goal_tick = -1;
+    *expanded = 0;
+    if (ready)
+    {
+        nodes[0] = {sim->frog.x, sim->frog.y, sim->game_ticks, -1, (short)(since_jump < JumpDelayTicks ? since_jump : JumpDelayTicks), ERR};
+        ready = sim->state == SimRunning && heap_push(&open, (uint64_t)solver_estimate(&nodes[0], &sim->finish) << 32, 0);
+    }
+
+    const int keys[] = {KEY_UP, KEY_LEFT, KEY_RIGHT, KEY_DOWN, ERR};
+    while (ready && goal < 0 && open.size > 0)
+    {
+        uint64_t priority;
+        int current;
+        heap_pop(&open, &priority, &current);
+        SolverNode node = nodes[current];
+        (*expanded)++;
+        if (!forecast_extend(&forecast, node.tick + 1))
+        {
+            break;
+        }
+
+        for (int key : keys)
+        {
+            Frog frog = {node.x, node.y};
+            int jumped = 0;
+            if (key != ERR)
+            {
+                if (node.since_jump < JumpDelayTicks)
+                {
+                    continue; // jeszcze nie mozna skoczyc
+                }
+                int last_jump_tick = -JumpDelayTicks;
+                frog_move(&frog, key, sim->config, &sim->occupancy, &last_jump_tick, 0);
+                if (frog.x == node.x && frog.y == node.y)
+                {
+                    continue; // sciana albo przeszkoda, taki skok nic nie daje
+                }
+                if (solver_hit(&forecast, frog.x, frog.y, node.tick))
+                {
+                    continue;
+                }
+                jumped = 1;
+            }
+
+            SolverNode next = {frog.x, frog.y, node.tick + 1, current, (short)(jumped ? 1 : node.since_jump + 1), (short)key};
+            if (next.since_jump > JumpDelayTicks)
+            {
+                next.since_jump = JumpDelayTicks;
+            }
+            bool at_finish = check_finish_collision(&frog, &sim->finish);
+            if (!at_finish && solver_hit(&forecast, frog.x, frog.y, next.tick))
+            {
+                continue; // samochody ruszyly sie na zabe
+            }
+
+            uint64_t state = ((uint64_t)next.tick * rows + next.y) * cols + next.x;
+            if (!at_finish && !state_set_insert(&closed, state, next.since_jump, &failed))
+            {
+                ready = !failed;
+                continue;
+            }
+            if (node_count == node_capacity)
+            {
+                SolverNode *grown = node_capacity < max_nodes ? (SolverNode *)realloc(nodes, sizeof(SolverNode) * node_capacity * 2) : nullptr;
+                if (grown == nullptr)
+                {
+                    ready = false; // za duzo stanow, poddajemy sie
+                    break;
+                }
+                nodes = grown;
+                node_capacity *= 2;
+            }
+            nodes[node_count] = next;
+            if (at_finish) // meta sprawdzana zaraz po skoku, przed ruchem samochodow
+            {
+                goal = node_count;
+                goal_tick = node.tick;
+                break;
+            }
+            uint64_t estimate = (uint64_t)(next.tick + solver_estimate(&next, &sim->finish));
+            if (!heap_push(&open, estimate << 32 | (uint32_t)(INT32_MAX - next.tick), node_count++)) // remis: glebszy stan pierwszy
+            {
+                ready = false;
+                break;
+            }
+        }
+    }
+
+    if (goal >= 0 && plan != nullptr)
+    {
+        int length = 0;
+        for (int i = goal; i > 0; i = nodes[i].parent)
+        {
+            length++;
+        }
+        int *path = (int *)malloc(sizeof(int) * (length + 1));
+        for (int i = goal, k = length; path != nullptr && i > 0; i = nodes[i].parent)
+        {
+            path[--k] = i; // od startu do mety
+        }
+        for (int k = 0; path != nullptr && k < length; k++)
+        {
+            SolverNode *step = &nodes[path[k]];
+            if (step->key != ERR)
+            {
+                recording_add(plan, step->tick - 1, step->key); // klawisz wcisniety klatke wczesniej
+            }
+        }
+        recording_finish(plan, goal_tick, SimWon);
+        goal_tick = path != nullptr ? goal_tick : -1;
+        free(path);
+    }
+
+    free(closed.keys);
+    heap_free(&open);
+    forecast_free(&forecast);
+    free(nodes);
+    return goal_tick;
+}
+
+//Solve the level from the current state and load the plan into a reader
+bool bot_plan(Simulation *sim, Recording *plan, ReplayReader *reader)
+{
+    long long start = monotonic_usec();
+    long expanded;
+    int ticks = solve_level(sim, plan, &expanded, SolverMaxNodes);
+    double milliseconds = (monotonic_usec() - start) / 1000.0;
+
+    if (ticks < 0)
+    {
+        fprintf(stderr, "Bot found no way to the finish (%ld states searched in %.1f ms)\n", expanded, milliseconds);
+        return false;
+    }
+    fprintf(stderr, "bot: finish at tick %d, %ld states searched in %.3f ms\n", ticks, expanded, milliseconds);
+    return replay_start(reader, plan->data, plan->size);
+}
+
+//HEADLESS FUNCTIONS
+
+//Run the simulation as fast as possible without a terminal
+int run_headless(Simulation *sim, long ticks)
+{
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    long tick = 0;
+    while (tick < ticks && simulation_step(sim, ERR) == SimRunning)
+    {
+        tick++;
+    }
+
+    gettimeofday(&end, NULL);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+    const char *result = sim->state == SimWon ? "won" : sim->state == SimLost ? "lost" : "running";
+    printf("seed: %llu\n", (unsigned long long)sim->seed);
+    printf("ticks: %ld\n", tick);
+    printf("result: %s at tick %d\n", result, sim->game_ticks);
+    if (sim->config.endless)
+    {
+        printf("distance: %d rows\n", endless_distance(sim));
+    }
+    printf("time: %.3f s\n", seconds);
+    printf("ticks per second: %.0f\n", seconds > 0 ? tick / seconds : 0.0);
+    return 0;
+}
+
+//MONTE CARLO FUNCTIONS
+
+//Results of the games played by one worker
+typedef struct
+{
+    long games;
+    long wins;
+    long losses;
+    long timeouts;
+    long total_ticks;
+    long total_distance; // wiersze przebyte w trybie endless
+    long *finish_seconds; // ile wygranych w kazdej sekundzie gry
+    long *death_rows; // ile smierci na kazdym wierszu
+    long *death_roads; // ile smierci na kolejnych drogach liczac od startu
+    long head_hits; // samochod trafil gorne pole zaby
+    long feet_hits; // samochod trafil dolne pole zaby
+    long *death_cells; // mapa smierci: wiersz x HeatmapWidth kolumn
+    long search_nodes; // galezie przeszukane przez polityke lookahead
+    long search_hits; // galezie wziete z tablicy transpozycji
+} MonteCarloStats;
+
+//Game indices of one worker, begin in the high and end in the low 32 bits, so both ends change with one CAS
+typedef struct
+{
+    atomic<uint64_t> range;
+} WorkQueue;
+
+uint64_t pack_range(uint64_t begin, uint64_t end)
+{
+    return (begin << 32) | end;
+}
+
+//Take a chunk from the own queue, or steal half of another worker's queue
+bool take_work(WorkQueue *queues, int self, int workers, long *begin, long *end)
+{
+    while (true)
+    {
+        uint64_t range = queues[self].range.load();
+        uint64_t first = range >> 32, last = range & 0xFFFFFFFFULL;
+        if (first < last)
+        {
+            uint64_t next = first + MonteCarloChunk < last ? first + MonteCarloChunk : last;
+            if (queues[self].range.compare_exchange_weak(range, pack_range(next, last)))
+            {
+                *begin = (long)first;
+                *end = (long)next;
+                return true;
+            }
+            continue; // ktos ukradl czesc naszej pracy, probujemy jeszcze raz
+        }
+
+        bool stolen = false;
+        for (int k = 1; k < workers && !stolen; k++) // szukamy ofiary z najblizszym numerem
+        {
+            WorkQueue *victim = &queues[(self + k) % workers];
+            uint64_t victim_range = victim->range.load();
+            uint64_t victim_first = victim_range >> 32, victim_last = victim_range & 0xFFFFFFFFULL;
+            if (victim_first >= victim_last)
+            {
+                continue;
+            }
+            uint64_t middle = victim_first + (victim_last - victim_first) / 2; // zabieramy gorna polowe
+            if (victim->range.compare_exchange_strong(victim_range, pack_range(victim_first, middle)))
+            {
+                queues[self].range.store(pack_range(middle, victim_last));
+                stolen = true;
+            }
+        }
+        if (!stolen)
+        {
+            return false; // nigdzie nie ma juz pracy
+        }
+    }
+}
+
+//Check if any hostile wheel is within radius cells of (x, y)
+bool hostile_near(Simulation *sim, int y, int x, int radius)
+{
+    for (int dx = -radius; dx <= radius; dx++)
+    {
+        if (occupancy_test(&sim->occupancy, sim->occupancy.hostile, y, x + dx))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Score of a position for the lookahead: finish first, then rows, then columns to the finish
+int lookahead_score(Simulation *sim, int depth)
+{
+    if (sim->state == SimWon)
+    {
+        return LookaheadWin + depth; // wczesniejsza wygrana lepsza
+    }
+    if (sim->state == SimLost)
+    {
+        return -LookaheadWin - depth; // pozniejsza smierc mniej zla
+    }
+    return -(sim->frog.y * sim->config.playing_area_width + abs(sim->frog.x - sim->finish.x));
+}
+
+//Best score reachable in depth more jumps; the game is left in an unspecified state
+int lookahead_value(Simulation *sim, Lookahead *lookahead, int depth, int *best_key)
+{
+    if (depth == 0 || sim->state != SimRunning)
+    {
+        return lookahead_score(sim, depth);
+    }
+
+    Snapshot *saved = (Snapshot *)(lookahead->snapshots + lookahead->size * depth);
+    if (!snapshot(sim, saved))
+    {
+        return lookahead_score(sim, depth); // bez migawek nie ma przeszukiwania
+    }
+    uint64_t key = snapshot_hash(saved, lookahead->size) ^ zobrist_key(~0ULL, (uint32_t)depth); // ten sam stan na innej glebokosci to inny wpis
+    int value;
+    if (best_key == nullptr && tt_probe(&lookahead->table, key, &value))
+    {
+        lookahead->hits++;
+        return value;
+    }
+
+    int keys[] = {KEY_UP, KEY_LEFT, KEY_RIGHT, ERR, KEY_DOWN, 'e'};
+    int actions = sim->push_car.waiting_to_push ? 6 : 5; // pchanie tylko gdy samochod czeka
+    int best = INT32_MIN;
+    for (int k = 0; k < actions; k++)
+    {
+        if (k > 0)
+        {
+            restore(sim, saved);
+        }
+        lookahead->nodes++;
+        simulation_input(sim, keys[k]);
+        for (int t = 0; t < JumpDelayTicks && sim->state == SimRunning; t++) // do nastepnej mozliwosci skoku
+        {
+            simulation_tick(sim);
+        }
+        int child = lookahead_value(sim, lookahead, depth - 1, nullptr);
+        if (child > best)
+        {
+            best = child;
+            if (best_key != nullptr)
+            {
+                *best_key = keys[k];
+            }
+        }
+    }
+    tt_store(&lookahead->table, key, best);
+    return best;
+}
+
+//Key of the best branch LookaheadDepth jumps ahead, searched on snapshots of the live game
+int lookahead_policy(Simulation *sim, Lookahead *lookahead)
+{
+    if (sim->game_ticks - sim->last_jump_tick < JumpDelayTicks) // i tak nie mozna skoczyc
+    {
+        return ERR;
+    }
+    Snapshot *root = (Snapshot *)lookahead->snapshots;
+    if (!snapshot(sim, root))
+    {
+        return ERR;
+    }
+    int key = ERR;
+    lookahead_value(sim, lookahead, LookaheadDepth, &key);
+    restore(sim, root);
+    return key;
+}
+
+//Pick a key for the frog: random walk biased towards the finish, or a walker that waits for a gap in the traffic;
+//with a forecast of the hostile lanes the walker sees the gap exactly instead of guessing from the distance to cars
+int frog_policy(Simulation *sim, Rng *rng, int policy, Forecast *forecast)
+{
+    Frog *frog = &sim->frog;
+
+    if (policy == PolicyRandom)
+    {
+        int r = get_random_number(rng, 0, 9);
+        int keys[10] = {KEY_UP, KEY_UP, KEY_UP, KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, 'e', ERR, ERR};
+        return keys[r];
+    }
+
+    if (sim->game_ticks - sim->last_jump_tick < JumpDelayTicks) // i tak nie mozna skoczyc
+    {
+        return ERR;
+    }
+
+    int radius = JumpDelayTicks + 2; // jak daleko samochod moze dojechac zanim zaba znowu skoczy
+    if (frog->y == sim->finish.y + 1 && frog->x != sim->finish.x) // pod meta idziemy w bok az do niej
+    {
+        return frog->x < sim->finish.x ? KEY_RIGHT : KEY_LEFT;
+    }
+
+    Frog up = {frog->x, frog->y - 1};
+    if (!check_collision_obstacle(&up, &sim->occupancy) && forecast != nullptr && forecast_extend(forecast, sim->game_ticks + JumpDelayTicks))
+    {
+        if (!forecast_danger(forecast, up.x, up.y, sim->game_ticks, JumpDelayTicks)) // nic nie przejedzie do nastepnego skoku
+        {
+            return KEY_UP;
+        }
+        if (forecast_danger(forecast, frog->x, frog->y, sim->game_ticks, JumpDelayTicks))
+        {
+            return KEY_DOWN; // samochod zaraz tu bedzie, uciekamy
+        }
+        return ERR; // czekamy na luke
+    }
+    if (!check_collision_obstacle(&up, &sim->occupancy))
+    {
+        if (!hostile_near(sim, up.y, up.x, radius))
+        {
+            return KEY_UP;
+        }
+        if (hostile_near(sim, frog->y, frog->x, 2) || hostile_near(sim, frog->y + 1, frog->x, 2))
+        {
+            return KEY_DOWN; // samochod tuz obok, uciekamy
+        }
+        return ERR; // czekamy na luke
+    }
+    return get_random_number(rng, 0, 1) ? KEY_LEFT : KEY_RIGHT; // przeszkoda nad zaba
+}
+
+//Play the games assigned to one worker
+void montecarlo_worker(GameConfig config, Options *options, WorkQueue *queues, int self, MonteCarloStats *stats)
+{
+    Simulation sim;
+    if (simulation_init(&sim, config, options->seed) != 0)
+    {
+        return;
+    }
+
+    //Lookahead searches on snapshots of the game, results shared by all games of this worker
+    Lookahead lookahead = {};
+    if (options->policy == PolicyLookahead)
+    {
+        lookahead.size = snapshot_size(&sim);
+        lookahead.snapshots = (unsigned char *)malloc(lookahead.size * (LookaheadDepth + 1));
+        if (lookahead.snapshots == nullptr || !tt_init(&lookahead.table, LookaheadTableBits))
+        {
+            free(lookahead.snapshots);
+            simulation_free(&sim);
+            return;
+        }
+    }
+
+    //Cautious walker previews the hostile lanes; endless rows and dense lanes do not move like the forecast
+    Forecast forecast = {};
+    bool forecasting = options->policy == PolicyCautious && !config.endless && !sim.lanes.dense && forecast_init(&forecast, &sim);
+
+    long max_ticks = options->ticks > 0 ? options->ticks : MonteCarloTicks;
+    long begin, end;
+    while (take_work(queues, self, options->threads, &begin, &end))
+    {
+        for (long game = begin; game < end; game++)
+        {
+            simulation_reset(&sim, options->seed + (uint64_t)game); // wynik nie zalezy od liczby watkow
+            Rng policy_rng;
+            rng_seed(&policy_rng, (options->seed + (uint64_t)game) ^ 0x5DEECE66DULL);
+            Forecast *preview = forecasting && forecast_start(&forecast, &sim) ? &forecast : nullptr;
+
+            while (sim.state == SimRunning && sim.game_ticks < max_ticks)
+            {
+                int key = options->policy == PolicyLookahead ? lookahead_policy(&sim, &lookahead) : frog_policy(&sim, &policy_rng, options->policy, preview);
+                simulation_step(&sim, key);
+            }
+
+            stats->games++;
+            stats->total_ticks += sim.game_ticks;
+            stats->total_distance += endless_distance(&sim);
+            if (sim.state == SimWon)
+            {
+                stats->wins++;
+                stats->finish_seconds[(long)sim.game_ticks * FrameDelay / 1000000]++;
+            }
+            else if (sim.state == SimLost)
+            {
+                stats->losses++;
+                int view_y = sim.frog.y - sim.occupancy.top; // wiersz na ekranie, w stalej planszy to samo co y
+                stats->death_rows[view_y]++;
+
+                //Which cell of the frog was hit and which road of the level that was
+                bool head = occupancy_test(&sim.occupancy, sim.occupancy.hostile, sim.frog.y, sim.frog.x);
+                int hit_row = head ? sim.frog.y : sim.frog.y + 1;
+                head ? stats->head_hits++ : stats->feet_hits++;
+                for (int road = 0; road < config.number_of_roads && !config.endless; road++) // w endless drogi ciagle sie zmieniaja
+                {
+                    if (sim.roads[road] == hit_row)
+                    {
+                        stats->death_roads[config.number_of_roads - 1 - road]++;
+                    }
+                }
+                stats->death_cells[(long)view_y * HeatmapWidth + (long)sim.frog.x * HeatmapWidth / config.playing_area_width]++;
+            }
+            else
+            {
+                stats->timeouts++;
+            }
+        }
+    }
+    stats->search_nodes = lookahead.nodes;
+    stats->search_hits = lookahead.hits;
+    free(lookahead.snapshots);
+    tt_free(&lookahead.table);
+    if (forecasting)
+    {
+        forecast_free(&forecast);
+    }
+    simulation_free(&sim);
+}
+
+//Simulate many independent seeded games on all cores and report how hard the config is
+int run_montecarlo(GameConfig config, Options *options)
+{
+    int workers = options->threads;
+    long games = options->montecarlo;
+    long max_ticks = options->ticks > 0 ? options->ticks : MonteCarloTicks;
+    long seconds = max_ticks * FrameDelay / 1000000 + 1;
+    int rows = config.playing_area_height;
+
+    //Every worker gets its own counters, merged at the end
+    MonteCarloStats *stats = (MonteCarloStats *)calloc(workers, sizeof(MonteCarloStats));
+    int roads = config.number_of_roads;
+    long per_worker = seconds + rows + roads + (long)rows * HeatmapWidth; // liczniki jednego watku
+    long *counters = (long *)calloc((size_t)workers * per_worker, sizeof(long));
+    WorkQueue *queues = new WorkQueue[workers];
+    if (stats == nullptr || counters == nullptr)
+    {
+        perror("Cannot allocate Monte Carlo counters");
+        free(stats);
+        free(counters);
+        delete[] queues;
+        return 1;
+    }
+    for (int w = 0; w < workers; w++)
+    {
+        long *mine = counters + (size_t)w * per_worker;
+        stats[w].finish_seconds = mine;
+        stats[w].death_rows = mine + seconds;
+        stats[w].death_roads = mine + seconds + rows;
+        stats[w].death_cells = mine + seconds + rows + roads;
+        queues[w].range.store(pack_range((uint64_t)(games * w / workers), (uint64_t)(games * (w + 1) / workers))); // rowny podzial na start
+    }
+
+    long long start = monotonic_usec();
+    thread *threads = new thread[workers];
+    for (int w = 0; w < workers; w++)
+    {
+        threads[w] = thread(montecarlo_worker, config, options, queues, w, &stats[w]);
+    }
+    for (int w = 0; w < workers; w++)
+    {
+        threads[w].join();
+    }
+    double elapsed = (monotonic_usec() - start) / 1000000.0;
+
+    //Merge into the first worker
+    MonteCarloStats *total = &stats[0];
+    for (int w = 1; w < workers; w++)
+    {
+        total->games += stats[w].games;
+        total->wins += stats[w].wins;
+        total->losses += stats[w].losses;
+        total->timeouts += stats[w].timeouts;
+        total->total_ticks += stats[w].total_ticks;
+        total->total_distance += stats[w].total_distance;
+        total->head_hits += stats[w].head_hits;
+        total->feet_hits += stats[w].feet_hits;
+        total->search_nodes += stats[w].search_nodes;
+        total->search_hits += stats[w].search_hits;
+        for (long i = 0; i < per_worker; i++)
+        {
+            total->finish_seconds[i] += stats[w].finish_seconds[i];
+        }
+    }
+
+    double win_rate = total->games > 0 ? (double)total->wins / total->games : 0.0;
+    double margin = total->games > 0 ? 1.96 * sqrt(win_rate * (1 - win_rate) / total->games) : 0.0;
+    printf("games: %ld in %.2f s (%.0f games/s, %.0f ticks/s, %d threads)\n", total->games, elapsed,
+           total->games / elapsed, total->total_ticks / elapsed, workers);
+    const char *policy_names[] = {"random", "cautious", "lookahead"};
+    printf("policy: %s, seeds %llu..%llu\n", policy_names[options->policy], (unsigned long long)options->seed,
+           (unsigned long long)(options->seed + games - 1));
+    if (options->policy == PolicyLookahead)
+    {
+        printf("lookahead: %ld branches searched, %ld taken from the transposition table\n", total->search_nodes, total->search_hits);
+    }
+    printf("win rate: %.2f%% +- %.2f%%\n", win_rate * 100, margin * 100);
+    printf("losses: %ld, timeouts: %ld\n", total->losses, total->timeouts);
+    if (config.endless)
+    {
+        printf("endless distance: %.1f rows per game\n", total->games > 0 ? (double)total->total_distance / total->games : 0.0);
+    }
+
+    //Time to finish: percentiles and a histogram by second
+    if (total->wins > 0)
+    {
+        long percentiles[3] = {total->wins / 10, total->wins / 2, total->wins * 9 / 10};
+        long seen = 0;
+        int p = 0;
+        printf("time to finish:");
+        for (long second = 0; second < seconds && p < 3; second++)
+        {
+            seen += total->finish_seconds[second];
+            while (p < 3 && seen > percentiles[p])
+            {
+                printf(" p%d %lds", p == 0 ? 10 : p == 1 ? 50 : 90, second);
+                p++;
+            }
+        }
+        printf("\n");
+
+        long most = 1;
+        for (long second = 0; second < seconds; second++)
+        {
+            most = total->finish_seconds[second] > most ? total->finish_seconds[second] : most;
+        }
+        for (long second = 0; second < seconds; second++)
+        {
+            if (total->finish_seconds[second] > 0)
+            {
+                printf("  %4lds %8ld |", second, total->finish_seconds[second]);
+                for (long bar = 0; bar < total->finish_seconds[second] * 50 / most; bar++)
+                {
+                    putchar('#');
+                }
+                printf("\n");
+            }
+        }
+    }
+
+    //Where the frog dies: row totals and a heatmap over the board
+    if (total->losses > 0)
+    {
+        const char *shades = " .:-=+*#%@";
+        long most = 1;
+        for (long i = 0; i < (long)rows * HeatmapWidth; i++)
+        {
+            most = total->death_cells[i] > most ? total->death_cells[i] : most;
+        }
+        printf("hostile hits: head %ld, feet %ld\n", total->head_hits, total->feet_hits);
+        if (!config.endless) // w endless drogi ciagle sie zmieniaja
+        {
+            printf("deaths by road (1 - first road after the start):\n");
+        }
+        for (int road = 0; road < roads && !config.endless; road++)
+        {
+            printf("  %4d %8ld\n", road + 1, total->death_roads[road]);
+        }
+        printf("deaths by row:\n");
+        for (int y = 0; y < rows; y++)
+        {
+            if (total->death_rows[y] == 0)
+            {
+                continue;
+            }
+            printf("  %4d %8ld |", y, total->death_rows[y]);
+            for (int x = 0; x < HeatmapWidth; x++)
+            {
+                long count = total->death_cells[(long)y * HeatmapWidth + x];
+                putchar(shades[count == 0 ? 0 : 1 + count * 8 / most]);
+            }
+            printf("|\n");
+        }
+    }
+
+    delete[] threads;
+    delete[] queues;
+    free(counters);
+    free(stats);
+    return 0;
+}
+
+//ENVIRONMENT FUNCTIONS
+
+//Keys behind the action numbers of the environment: wait, four jumps, push
+const int env_action_keys[EnvActions] = {ERR, KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT, 'e'};
+
+//Values of the observation cells
+typedef enum
+{
+    CellEmpty,
+    CellRoad,
+    CellObstacle,
+    CellFinish,
+    CellHostile, // CellHostile + CarKind dla kazdego rodzaju samochodu
+    CellFriendly,
+    CellStopping,
+    CellFrog
+} ObservationCell;
+
+typedef enum
+{
+    EnvRunning,
+    EnvTerminal, // wygrana albo przegrana
+    EnvTruncated // limit tickow epizodu
+} EnvDone;
+
+typedef enum
+{
+    EnvJobReset,
+    EnvJobStep,
+    EnvJobQuit
+} EnvJob;
+
+//N independent games stepped in lockstep; arrays are indexed by game, observations are rows * cols bytes per game
+typedef struct
+{
+    int count;
+    int rows;
+    int cols;
+    long max_ticks; // po tylu tickach epizod jest uciety
+    Simulation *games;
+    uint8_t *background; // drogi, przeszkody i meta kazdej gry, budowane przy resecie
+    uint8_t *observations;
+    float *rewards;
+    uint8_t *dones; // EnvDone ostatniego kroku
+    int *best_y; // najwyzszy osiagniety wiersz, nagroda tylko za nowy postep
+    const uint64_t *seeds; // argumenty biezacego zlecenia
+    const int *actions;
+    int workers;
+    thread *threads;
+    EnvJob job;
+    atomic<long> generation; // numer zlecenia, watki czekaja na jego zmiane
+    atomic<int> pending; // watki ktore jeszcze licza biezace zlecenie
+    atomic<int> sleeping; // watki uspione na wake, zlecajacy budzi je tylko gdy sa
+    mutex lock;
+    condition_variable wake;
+} VecEnv;
+
+//Static cells of one game after a reset
+void env_build_background(VecEnv *env, int i)
+{
+    Simulation *sim = &env->games[i];
+    uint8_t *cells = env->background + (size_t)i * env->rows * env->cols;
+    for (int y = 0; y < env->rows; y++)
+    {
+        memset(cells + y * env->cols, sim->used_flags[y] ? CellRoad : CellEmpty, env->cols);
+    }
+    for (int k = 0; k < sim->config.number_of_obstacles; k++)
+    {
+        cells[sim->obstacle[k].y * env->cols + sim->obstacle[k].x] = CellObstacle;
+    }
+    cells[sim->finish.y * env->cols + sim->finish.x] = CellFinish;
+}
+
+//Static cells, then cars and the frog on top
+void env_observe(VecEnv *env, int i)
+{
+    Simulation *sim = &env->games[i];
+    size_t size = (size_t)env->rows * env->cols;
+    uint8_t *cells = env->observations + i * size;
+    memcpy(cells, env->background + i * size, size);
+
+    CarStore *cars = &sim->cars;
+    for (int kind = 0; kind < CarKinds; kind++)
+    {
+        for (int c = cars->begin[kind]; c < cars->begin[kind + 1]; c++)
+        {
+            uint8_t *row = cells + cars->y[c] * env->cols;
+            for (int x = cars->x[c]; x < cars->x[c] + 3; x++)
+            {
+                if (x >= 0 && x < env->cols)
+                {
+                    row[x] = (uint8_t)(CellHostile + kind);
+                }
+            }
+        }
+    }
+    cells[sim->frog.y * env->cols + sim->frog.x] = CellFrog;
+    cells[(sim->frog.y + 1) * env->cols + sim->frog.x] = CellFrog;
+}
+
+void env_reset_game(VecEnv *env, int i, uint64_t seed)
+{
+    simulation_reset(&env->games[i], seed);
+    env->best_y[i] = env->games[i].frog.y;
+    env_build_background(env, i);
+    env_observe(env, i);
+}
+
+//One step of one game: +1 win, -1 loss, progress towards the finish in between; a finished game restarts at once
+void env_step_game(VecEnv *env, int i, int action)
+{
+    Simulation *sim = &env->games[i];
+    simulation_step(sim, action >= 0 && action < EnvActions ? env_action_keys[action] : ERR);
+
+    float reward = 0;
+    if (sim->frog.y < env->best_y[i])
+    {
+        reward = (float)(env->best_y[i] - sim->frog.y) / env->rows;
+        env->best_y[i] = sim->frog.y;
+    }
+    EnvDone done = EnvRunning;
+    if (sim->state != SimRunning)
+    {
+        reward += sim->state == SimWon ? 1.0f : -1.0f;
+        done = EnvTerminal;
+    }
+    else if (sim->game_ticks >= env->max_ticks)
+    {
+        done = EnvTruncated;
+    }
+    env->rewards[i] = reward;
+    env->dones[i] = (uint8_t)done;
+
+    if (done != EnvRunning)
+    {
+        env_reset_game(env, i, sim->seed + (uint64_t)env->count); // kolejne ziarna nie zaleza od liczby watkow
+    }
+    else
+    {
+        env_observe(env, i);
+    }
+}
+
+//Games of one worker: an equal slice of the batch
+void env_run_slice(VecEnv *env, int worker)
+{
+    int begin = (int)((long)env->count * worker / env->workers), end = (int)((long)env->count * (worker + 1) / env->workers);
+    for (int i = begin; i < end; i++)
+    {
+        if (env->job == EnvJobReset)
+        {
+            env_reset_game(env, i, env->seeds[i]);
+        }
+        else
+        {
+            env_step_game(env, i, env->actions[i]);
+        }
+    }
+}
+
+//Worker thread: wait for the next job, run its slice, report back
+void env_worker(VecEnv *env, int worker)
+{
+    long seen = 0;
+    while (true)
+    {
+        long generation;
+        for (int spin = 0; (generation = env->generation.load(memory_order_acquire)) == seen; spin++)
+        {
+            if (spin < EnvSpins)
+            {
+                this_thread::yield(); // kroki ida zwykle jeden za drugim, krotkie czekanie bez usypiania
+                continue;
+            }
+            //Caller busy with something else: sleep until the next job instead of burning the core
+            env->sleeping.fetch_add(1);
+            {
+                unique_lock<mutex> guard(env->lock);
+                env->wake.wait(guard, [env, seen] { return env->generation.load() != seen; });
+            }
+            env->sleeping.fetch_sub(1);
+        }
+        seen = generation;
+        if (env->job == EnvJobQuit)
+        {
+            return;
+        }
+        env_run_slice(env, worker);
+        env->pending.fetch_sub(1, memory_order_release);
+    }
+}
+
+//Hand the job to all workers, the calling thread takes slice 0
+void env_dispatch(VecEnv *env, EnvJob job)
+{
+    env->job = job;
+    env->pending.store(env->workers - 1, memory_order_relaxed);
+    env->generation.fetch_add(1); // seq_cst z sleeping: uspiony watek albo zobaczy nowe zlecenie, albo zostanie obudzony
+    if (env->sleeping.load() > 0)
+    {
+        lock_guard<mutex> guard(env->lock); // watek miedzy sprawdzeniem warunku a zasnieciem nie przegapi sygnalu
+        env->wake.notify_all();
+    }
+    if (job == EnvJobQuit)
+    {
+        return;
+    }
+    env_run_slice(env, 0);
+    while (env->pending.load(memory_order_acquire) > 0)
+    {
+        this_thread::yield();
+    }
+}
+
+int env_init(VecEnv *env, GameConfig config, int count, int workers, long max_ticks)
+{
+    env->count = count;
+    env->rows = config.playing_area_height;
+    env->cols = config.playing_area_width;
+    env->max_ticks = max_ticks;
+    env->workers = workers < 1 ? 1 : workers > count ? count : workers;
+    env->generation.store(0);
+    env->pending.store(0);
+    env->sleeping.store(0);
+
+    size_t size = (size_t)count * env->rows * env->cols;
+    env->games = (Simulation *)calloc(count, sizeof(Simulation));
+    env->background = (uint8_t *)malloc(size);
+    env->observations = (uint8_t *)malloc(size);
+    env->rewards = (float *)calloc(count, sizeof(float));
+    env->dones = (uint8_t *)calloc(count, 1);
+    env->best_y = (int *)calloc(count, sizeof(int));
+    if (env->games == nullptr || env->background == nullptr || env->observations == nullptr || env->rewards == nullptr ||
+        env->dones == nullptr || env->best_y == nullptr)
+    {
+        perror("Cannot allocate environments");
+        env->count = 0;
+        return 1;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (simulation_init(&env->games[i], config, (uint64_t)i) != 0)
+        {
+            env->count = i;
+            return 1;
+        }
+    }
+
+    env->threads = new thread[env->workers];
+    for (int w = 1; w < env->workers; w++)
+    {
+        env->threads[w] = thread(env_worker, env, w);
+    }
+    return 0;
+}
+
+//Start every game from its own seed
+void env_reset(VecEnv *env, const uint64_t *seeds)
+{
+    env->seeds = seeds;
+    env_dispatch(env, EnvJobReset);
+}
+
+//One action per game; rewards, dones and observations are ready on return
+void env_step(VecEnv *env, const int *actions)
+{
+    env->actions = actions;
+    env_dispatch(env, EnvJobStep);
+}
+
+void env_free(VecEnv *env)
+{
+    if (env->threads != nullptr)
+    {
+        env_dispatch(env, EnvJobQuit);
+        for (int w = 1; w < env->workers; w++)
+        {
+            env->threads[w].join();
+        }
+        delete[] env->threads;
+    }
+    for (int i = 0; i < env->count; i++)
+    {
+        simulation_free(&env->games[i]);
+    }
+    free(env->games);
+    free(env->background);
+    free(env->observations);
+    free(env->rewards);
+    free(env->dones);
+    free(env->best_y);
+}
+
+//Random agents for a fixed time: steps per second of the whole batch
+int run_envbench(GameConfig config, Options *options)
+{
+    int count = (int)options->envbench;
+    VecEnv env = {};
+    uint64_t *seeds = (uint64_t *)malloc(sizeof(uint64_t) * count);
+    int *actions = (int *)malloc(sizeof(int) * (size_t)count * EnvActionRounds);
+    if (seeds == nullptr || actions == nullptr ||
+        env_init(&env, config, count, options->threads, options->ticks > 0 ? options->ticks : MonteCarloTicks) != 0)
+    {
+        perror("Cannot start environments");
+        env_free(&env);
+        free(seeds);
+        free(actions);
+        return 1;
+    }
+
+    //Actions drawn up front, so the benchmark measures only the environment
+    Rng rng;
+    rng_seed(&rng, options->seed);
+    for (long i = 0; i < (long)count * EnvActionRounds; i++)
+    {
+        actions[i] = get_random_number(&rng, 0, EnvActions - 1);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        seeds[i] = options->seed + (uint64_t)i;
+    }
+    env_reset(&env, seeds);
+
+    long steps = 0, wins = 0, losses = 0, truncated = 0;
+    double total_reward = 0;
+    long long start = monotonic_nsec(), elapsed;
+    do
+    {
+        env_step(&env, actions + (size_t)(steps % EnvActionRounds) * count);
+        for (int i = 0; i < count; i++)
+        {
+            total_reward += env.rewards[i];
+            if (env.dones[i] == EnvTerminal)
+            {
+                (env.rewards[i] > 0 ? wins : losses)++;
+            }
+            truncated += env.dones[i] == EnvTruncated;
+        }
+        steps++;
+        elapsed = monotonic_nsec() - start;
+    } while (elapsed < EnvBenchNanoseconds);
+
+    double seconds = elapsed / 1e9;
+    printf("games: %d, observation: %dx%d bytes, threads: %d\n", count, env.cols, env.rows, env.workers);
+    printf("batches: %ld (%.1f us each)\n", steps, elapsed / 1000.0 / steps);
+    printf("steps: %ld (%.0f steps/s)\n", steps * count, steps * count / seconds);
+    printf("episodes: %ld won, %ld lost, %ld truncated, reward %.3f per step\n", wins, losses, truncated,
+           total_reward / ((double)steps * count));
+
+    env_free(&env);
+    free(seeds);
+    free(actions);
+    return 0;
+}
+
+
+//LEVEL FUNCTIONS
+
+//One generated level: the seed that builds it and its shortest finish tick (-1 - rejected)
+typedef struct
+{
+    uint64_t seed;
+    int ticks;
+} Level;
+
+//Build levels from consecutive seeds and keep only those the solver can finish
+void level_worker(GameConfig config, Options *options, WorkQueue *queues, int self, Level *levels)
+{
+    Simulation sim;
+    if (simulation_init(&sim, config, options->seed) != 0)
+    {
+        return;
+    }
+
+    long budget = LevelMaxNodes + (long)config.playing_area_width * config.playing_area_height;
+    int max_nodes = budget < SolverMaxNodes ? (int)budget : SolverMaxNodes;
+
+    long begin, end;
+    while (take_work(queues, self, options->threads, &begin, &end))
+    {
+        for (long level = begin; level < end; level++)
+        {
+            long expanded;
+            simulation_reset(&sim, options->seed + (uint64_t)level);
+            levels[level].seed = sim.seed;
+            levels[level].ticks = solve_level(&sim, nullptr, &expanded, max_nodes); // szybki test osiagalnosci mety
+        }
+    }
+    simulation_free(&sim);
+}
+
+int compare_ints(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+//Generate levels on all cores and write the solvable ones to a level pack
+int run_generate(GameConfig config, Options *options)
+{
+    int workers = options->threads;
+    long count = options->generate;
+    Level *levels = (Level *)calloc(count, sizeof(Level));
+    int *ticks = (int *)malloc(sizeof(int) * count);
+    WorkQueue *queues = new WorkQueue[workers];
+    FILE *file = fopen(options->pack_file, "wb");
+    if (levels == nullptr || ticks == nullptr || file == nullptr)
+    {
+        perror("Cannot write level pack");
+        free(levels);
+        free(ticks);
+        delete[] queues;
+        if (file != nullptr)
+        {
+            fclose(file);
+        }
+        return 1;
+    }
+    for (long i = 0; i < count; i++)
+    {
+        levels[i].ticks = -1; // poziom, do ktorego nie dotarl zaden watek, nie trafi do paczki
+    }
+    for (int w = 0; w < workers; w++)
+    {
+        queues[w].range.store(pack_range((uint64_t)(count * w / workers), (uint64_t)(count * (w + 1) / workers)));
+    }
+
+    long long start = monotonic_usec();
+    thread *threads = new thread[workers];
+    for (int w = 0; w < workers; w++)
+    {
+        threads[w] = thread(level_worker, config, options, queues, w, levels);
+    }
+    for (int w = 0; w < workers; w++)
+    {
+        threads[w].join();
+    }
+    double elapsed = (monotonic_usec() - start) / 1000000.0;
+
+    //Header, then seed and finish tick of every accepted level in seed order
+    long accepted = 0;
+    for (long i = 0; i < count; i++)
+    {
+        if (levels[i].ticks >= 0)
+        {
+            ticks[accepted++] = levels[i].ticks;
+        }
+    }
+    fwrite("JFLP", 1, 4, file);
+    fputc(LevelVersion, file);
+    config_write(file, &config);
+    write_int(file, (uint64_t)accepted, 4);
+    for (long i = 0; i < count; i++)
+    {
+        if (levels[i].ticks >= 0)
+        {
+            write_int(file, levels[i].seed, 8);
+            write_int(file, (uint32_t)levels[i].ticks, 4);
+        }
+    }
+    bool written = fclose(file) == 0;
+
+    printf("levels: %ld of %ld solvable in %.2f s (%.0f levels/s, %d threads)\n", accepted, count, elapsed,
+           elapsed > 0 ? count / elapsed : 0.0, workers);
+    if (accepted > 0)
+    {
+        qsort(ticks, accepted, sizeof(int), compare_ints);
+        printf("shortest finish: min %d, median %d, max %d ticks\n", ticks[0], ticks[accepted / 2], ticks[accepted - 1]);
+    }
+    printf("pack: %s\n", options->pack_file);
+
+    delete[] threads;
+    delete[] queues;
+    free(levels);
+    free(ticks);
+    if (!written)
+    {
+        perror("Cannot write level pack");
+        return 1;
+    }
+    return 0;
+}
+
+//Read the config and the seed of one level from a pack
+int load_level(const char *file_name, long index, GameConfig *config, uint64_t *seed)
+{
+    FILE *file = fopen(file_name, "rb");
+    if (file == nullptr)
+    {
+        perror("Cannot open level pack");
+        return 1;
+    }
+
+    unsigned char header[4 + 1 + 7 * 4 + 4], entry[8 + 4];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, "JFLP", 4) != 0 || header[4] != LevelVersion)
+    {
+        fprintf(stderr, "Not a level pack: %s\n", file_name);
+        fclose(file);
+        return 1;
+    }
+
+    long count = (long)read_int(header + 33, 4); // poziomy maja staly rozmiar, czytamy tylko jeden
+    if (index < 0 || index >= count || fseek(file, (long)sizeof(header) + index * (long)sizeof(entry), SEEK_SET) != 0 ||
+        fread(entry, 1, sizeof(entry), file) != sizeof(entry))
+    {
+        fprintf(stderr, "Level %ld is not in the pack (%ld levels)\n", index, count);
+        fclose(file);
+        return 1;
+    }
+
+    config_read(header + 5, config);
+    *seed = read_int(entry, 8);
+    fclose(file);
+    return 0;
+}
+
+
+//BENCHMARK FUNCTIONS
+
+typedef void (*BenchFunction)(void *context, long iterations);
+
+//What the collision benchmarks test: random frog positions on one board
+typedef struct
+{
+    Simulation *sim;
+    Frog frogs[BenchPositions];
+    Forecast forecast; // wrogie pasy na BenchPositions klatek do przodu
+    long hits; // wynik uzywany, zeby kompilator nie wyrzucil wywolan
+} CollisionBench;
+
+typedef struct
+{
+    WINDOW *board_win;
+    Renderer *renderer;
+    Simulation *sim;
+} RenderBench;
+
+typedef struct
+{
+    Simulation *sim;
+    Snapshot *snap;
+    size_t size;
+    TranspositionTable table;
+    uint64_t sink; // wyniki, zeby kompilator nie wyrzucil petli
+} SnapshotBench;
+
+//Run the function with more and more iterations until it takes BenchNanoseconds, returns ns per iteration
+double bench_run(BenchFunction function, void *context, long *iterations)
+{
+    *iterations = 1;
+    while (true)
+    {
+        long long start = monotonic_nsec();
+        function(context, *iterations);
+        long long elapsed = monotonic_nsec() - start;
+        if (elapsed >= BenchNanoseconds)
+        {
+            return (double)elapsed / *iterations;
+        }
+        *iterations *= elapsed < BenchNanoseconds / 16 ? 8 : 2;
+    }
+}
+
+void bench_report(const char *name, double nanoseconds, long iterations, const char *extra)
+{
+    printf("%-36s %12.1f ns/op %12ld ops  %s\n", name, nanoseconds, iterations, extra);
+}
+
+//Config for a board with the given size, every road has a car
+GameConfig bench_config(int width, int height, int roads)
+{
+    GameConfig config;
+    config.playing_area_width = width;
+    config.playing_area_height = height;
+    config.number_of_roads = roads;
+    config.number_of_friendly_cars = roads / 3;
+    config.number_of_stopping_cars = roads / 3;
+    config.number_of_hostile_cars = roads - 2 * (roads / 3);
+    config.number_of_obstacles = (height - 7 - roads) / 2;
+    config.endless = 0;
+    return config;
+}
+
+//Board of a benchmark, checked like a config file so no row times a board the game would refuse
+bool bench_init(Simulation *sim, GameConfig config)
+{
+    sim->arena.base = nullptr; // simulation_free po nieudanym starcie nic nie zwalnia
+    return validate_config(&config) == 0 && simulation_init(sim, config, 1) == 0;
+}
+
+//Whole tick with the frog kept alive at the start, so the game never ends
+void bench_tick(void *context, long iterations)
+{
+    Simulation *sim = (Simulation *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        simulation_tick(sim);
+        sim->state = SimRunning;
+    }
+}
+
+void bench_move_cars(void *context, long iterations)
+{
+    Simulation *sim = (Simulation *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        move_cars(&sim->cars, sim->config, sim->game_ticks, &sim->frog, &sim->push_car, &sim->occupancy, &sim->rng, &sim->hostile_rng);
+        sim->game_ticks = (sim->game_ticks + 1) % 6; // predkosci 1-3 powtarzaja sie co 6 klatek
+    }
+}
+
+void bench_hostile_collision(void *context, long iterations)
+{
+    CollisionBench *bench = (CollisionBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        bench->hits += check_collision_hostile_car(&bench->frogs[i % BenchPositions], &bench->sim->occupancy);
+    }
+}
+
+void bench_obstacle_collision(void *context, long iterations)
+{
+    CollisionBench *bench = (CollisionBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        bench->hits += check_collision_obstacle(&bench->frogs[i % BenchPositions], &bench->sim->occupancy);
+    }
+}
+
+void bench_friendly_collision(void *context, long iterations)
+{
+    CollisionBench *bench = (CollisionBench *)context;
+    Simulation *sim = bench->sim;
+    for (long i = 0; i < iterations; i++)
+    {
+        check_collision_friendly_car(&bench->frogs[i % BenchPositions], &sim->cars, &sim->occupancy, sim->row_car, &sim->lanes, &sim->push_car);
+        bench->hits += sim->push_car.car_index >= 0;
+    }
+}
+
+void bench_finish_collision(void *context, long iterations)
+{
+    CollisionBench *bench = (CollisionBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        bench->hits += check_finish_collision(&bench->frogs[i % BenchPositions], &bench->sim->finish);
+    }
+}
+
+//Future collisions at random frog positions and ticks up to BenchPositions ahead, in no particular order
+void bench_forecast_collision(void *context, long iterations)
+{
+    CollisionBench *bench = (CollisionBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        Frog *frog = &bench->frogs[i % BenchPositions];
+        bench->hits += solver_hit(&bench->forecast, frog->x, frog->y, (int)((i * 389) % BenchPositions));
+    }
+}
+
+void bench_snapshot(void *context, long iterations)
+{
+    SnapshotBench *bench = (SnapshotBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        snapshot(bench->sim, bench->snap);
+        bench->sink += bench->snap->game_ticks;
+    }
+}
+
+void bench_restore(void *context, long iterations)
+{
+    SnapshotBench *bench = (SnapshotBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        restore(bench->sim, bench->snap);
+    }
+}
+
+void bench_snapshot_hash(void *context, long iterations)
+{
+    SnapshotBench *bench = (SnapshotBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        bench->snap->game_ticks = (int32_t)i; // inny stan w kazdej iteracji
+        bench->sink += snapshot_hash(bench->snap, bench->size);
+    }
+}
+
+//Store and probe at random keys, the table much larger than the cache
+void bench_transposition(void *context, long iterations)
+{
+    SnapshotBench *bench = (SnapshotBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        uint64_t key = zobrist_key(0, (uint32_t)i);
+        int value;
+        tt_store(&bench->table, key, (int)i);
+        bench->sink += tt_probe(&bench->table, key ^ 1, &value);
+    }
+}
+
+void bench_initialize(void *context, long iterations)
+{
+    Simulation *sim = (Simulation *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        initialize_game_elements(sim);
+    }
+}
+
+void bench_render(void *context, long iterations)
+{
+    RenderBench *bench = (RenderBench *)context;
+    for (long i = 0; i < iterations; i++)
+    {
+        simulation_tick(bench->sim); // zaba stoi na starcie, gra sie nie konczy
+        refresh_screen(bench->board_win, bench->renderer, bench->sim);
+    }
+}
+
+//Full frames into an off-screen terminal on /dev/null, through ncurses or the ANSI backend
+int bench_rendering(GameConfig config, bool use_ansi)
+{
+    FILE *output = fopen("/dev/null", "w");
+    FILE *input = fopen("/dev/null", "r");
+    SCREEN *screen = output && input ? newterm("xterm-256color", output, input) : nullptr;
+    if (screen == nullptr)
+    {
+        fprintf(stderr, "Cannot create off-screen terminal, skipping render benchmark\n");
+        if (output != nullptr)
+        {
+            fclose(output);
+        }
+        if (input != nullptr)
+        {
+            fclose(input);
+        }
+        return 1;
+    }
+    int lines = config.playing_area_height + 10, columns = config.playing_area_width + 60; // miejsce na plansze i display_info
+    resizeterm(lines, columns);
+    curs_set(FALSE);
+    noecho();
+    initialize_colors();
+
+    Simulation sim;
+    Renderer renderer;
+    WINDOW *board_win = create_board(config.playing_area_height, config.playing_area_width);
+    bool ready = board_win != nullptr && bench_init(&sim, config);
+    int sockets[2] = {-1, -1};
+    AnsiScreen ansi = {};
+    if (ready && renderer_init(&renderer, &sim) == 0)
+    {
+        if (use_ansi && ansi_screen_alloc(&ansi, lines, columns))
+        {
+            ansi.fd = fileno(output);
+            renderer.ansi = &ansi;
+        }
+        draw_initial_state(board_win, &renderer, &sim);
+        RenderBench bench = {board_win, &renderer, &sim};
+        long iterations;
+        double nanoseconds = bench_run(bench_render, &bench, &iterations);
+
+        //Count bytes and write() calls of a fixed number of frames: on a packet socket every write is one packet
+        long long bytes = -1, writes = -1;
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets) == 0 && dup2(sockets[0], fileno(output)) >= 0)
+        {
+            bytes = writes = 0;
+            char packet[4096];
+            for (int frame = 0; frame < BenchFrames; frame++)
+            {
+                bench_render(&bench, 1);
+                ssize_t size;
+                while ((size = recv(sockets[1], packet, sizeof(packet), MSG_DONTWAIT | MSG_TRUNC)) > 0) // MSG_TRUNC - pelna dlugosc pakietu
+                {
+                    bytes += size;
+                    writes++;
+                }
+            }
+        }
+        char extra[64], name[64];
+        snprintf(extra, sizeof(extra), "%.1f bytes/frame, %.2f writes/frame", (double)bytes / BenchFrames, (double)writes / BenchFrames);
+        snprintf(name, sizeof(name), "refresh_screen %s %dx%d", use_ansi ? "ansi" : "ncurses", config.playing_area_width,
+                 config.playing_area_height);
+        bench_report(name, nanoseconds, iterations, extra);
+        ansi_screen_free(&ansi);
+        renderer_free(&renderer);
+    }
+    if (ready)
+    {
+        simulation_free(&sim);
+    }
+    if (board_win != nullptr)
+    {
+        delwin(board_win);
+    }
+    endwin();
+    delscreen(screen);
+    fclose(output);
+    fclose(input);
+    for (int fd : sockets) // odbiorca zamykany po endwin, ktory jeszcze pisze do terminala
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    return 0;
+}
+
+//Hot paths of the engine and the renderer, for catching regressions
+int run_bench()
+{
+    long iterations;
+    char name[64], extra[64];
+
+    //Car kernels at growing car counts
+    int car_counts[] = {8, 64, 512, 4096};
+    for (int cars : car_counts)
+    {
+        Simulation sim;
+        if (!bench_init(&sim, bench_config(200, cars + 10, cars)))
+        {
+            simulation_free(&sim);
+            return 1;
+        }
+        double nanoseconds = bench_run(bench_move_cars, &sim, &iterations);
+        snprintf(name, sizeof(name), "move_cars %d cars", cars);
+        snprintf(extra, sizeof(extra), "%.2f ns/car", nanoseconds / cars);
+        bench_report(name, nanoseconds, iterations, extra);
+        simulation_free(&sim);
+    }
+
+    //Dense traffic: many cars in every lane
+    int per_lane[] = {1, 10, 40};
+    for (int count : per_lane)
+    {
+        Simulation sim;
+        GameConfig config = bench_config(200, 60, 20);
+        config.number_of_hostile_cars *= count;
+        config.number_of_friendly_cars *= count;
+        config.number_of_stopping_cars *= count;
+        if (!bench_init(&sim, config))
+        {
+            simulation_free(&sim);
+            return 1;
+        }
+        double nanoseconds = bench_run(bench_tick, &sim, &iterations);
+        long moved = 0;
+        for (int tick = 0; tick < BenchFrames; tick++) // ile samochodow naprawde jedzie, zakorkowany pas liczy sie szybko
+        {
+            bench_tick(&sim, 1);
+            for (int i = 0; i < sim.cars.count; i++)
+            {
+                moved += sim.cars.x[i] != sim.cars.old_x[i];
+            }
+        }
+        snprintf(name, sizeof(name), "simulation_tick 200x60 %d cars/lane", count);
+        snprintf(extra, sizeof(extra), "%.2f ns/car, %.0f%% moving", nanoseconds / sim.cars.count,
+                 100.0 * moved / ((double)BenchFrames * sim.cars.count));
+        bench_report(name, nanoseconds, iterations, extra);
+        simulation_free(&sim);
+    }
+
+    //Collision checks at random frog positions on the default sized board
+    Simulation sim;
+    if (!bench_init(&sim, bench_config(60, 25, 8)))
+    {
+        simulation_free(&sim);
+        return 1;
+    }
+    CollisionBench collision;
+    collision.sim = &sim;
+    collision.hits = 0;
+    for (int i = 0; i < BenchPositions; i++)
+    {
+        collision.frogs[i].x = get_random_number(&sim.rng, 1, sim.config.playing_area_width - 2);
+        collision.frogs[i].y = get_random_number(&sim.rng, 1, sim.config.playing_area_height - 3);
+    }
+    BenchFunction checks[] = {bench_hostile_collision, bench_obstacle_collision, bench_friendly_collision, bench_finish_collision};
+    const char *check_names[] = {"check_collision_hostile_car", "check_collision_obstacle", "check_collision_friendly_car",
+                                 "check_finish_collision"};
+    for (int k = 0; k < 4; k++)
+    {
+        double nanoseconds = bench_run(checks[k], &collision, &iterations);
+        bench_report(check_names[k], nanoseconds, iterations, "");
+    }
+    if (!forecast_init(&collision.forecast, &sim) || !forecast_start(&collision.forecast, &sim) ||
+        !forecast_extend(&collision.forecast, BenchPositions))
+    {
+        forecast_free(&collision.forecast);
+        simulation_free(&sim);
+        return 1;
+    }
+    double forecast_nanoseconds = bench_run(bench_forecast_collision, &collision, &iterations);
+    snprintf(extra, sizeof(extra), "%ld speed changes", collision.forecast.changes);
+    bench_report("forecast hit, 0..1023 ticks ahead", forecast_nanoseconds, iterations, extra);
+    forecast_free(&collision.forecast);
+
+    //Snapshots of the same game for branching search
+    SnapshotBench snapshots;
+    snapshots.sim = &sim;
+    snapshots.size = snapshot_size(&sim);
+    snapshots.snap = (Snapshot *)malloc(snapshots.size);
+    snapshots.sink = 0;
+    if (snapshots.snap == nullptr || !tt_init(&snapshots.table, LookaheadTableBits + 4))
+    {
+        free(snapshots.snap);
+        simulation_free(&sim);
+        return 1;
+    }
+    snapshot(&sim, snapshots.snap);
+    BenchFunction snapshot_checks[] = {bench_snapshot, bench_restore, bench_snapshot_hash, bench_transposition};
+    const char *snapshot_names[] = {"snapshot", "restore", "snapshot_hash", "tt_store + tt_probe"};
+    for (int k = 0; k < 4; k++)
+    {
+        double nanoseconds = bench_run(snapshot_checks[k], &snapshots, &iterations);
+        snprintf(extra, sizeof(extra), "%zu bytes", snapshots.size);
+        bench_report(snapshot_names[k], nanoseconds, iterations, k < 3 ? extra : "");
+    }
+    free(snapshots.snap);
+    tt_free(&snapshots.table);
+    simulation_free(&sim);
+
+    //Level generation at growing board sizes
+    int sizes[][2] = {{60, 25}, {250, 100}, {1000, 500}, {4000, 2000}};
+    for (auto &size : sizes)
+    {
+        if (!bench_init(&sim, bench_config(size[0], size[1], size[1] / 2)))
+        {
+            simulation_free(&sim);
+            return 1;
+        }
+        double nanoseconds = bench_run(bench_initialize, &sim, &iterations);
+        snprintf(name, sizeof(name), "initialize_game_elements %dx%d", size[0], size[1]);
+        bench_report(name, nanoseconds, iterations, "");
+        simulation_free(&sim);
+    }
+
+    //Whole frames into an off-screen terminal
+    GameConfig render_configs[] = {bench_config(60, 25, 8), bench_config(200, 60, 40)};
+    for (GameConfig config : render_configs)
+    {
+        bench_rendering(config, false);
+        bench_rendering(config, true);
+    }
+    return 0;
+}
+
+
+//SERVER FUNCTIONS
+
+typedef enum
+{
+    InputNormal,
+    InputIac, // telnet: IAC
+    InputIacOption, // telnet: IAC WILL/WONT/DO/DONT
+    InputSub, // telnet: IAC SB ... IAC SE
+    InputSubIac,
+    InputEscape,
+    InputCsi // ESC [ albo ESC O
+} InputState;
+
+//One connected player; everything main() keeps in locals for the terminal game
+typedef struct
+{
+    int fd;
+    int index; // miejsce w tablicy sesji
+    Simulation sim;
+    Renderer renderer;
+    AnsiScreen screen;
+    InputState input;
+    InputQueue queue; // klawisze czekajace na koniec skoku
+    size_t out_sent; // ile z screen.out juz poszlo do klienta
+    bool writing; // czekamy na EPOLLOUT
+    int start_tick; // kiedy zaczela sie obecna gra
+} Session;
+
+typedef struct
+{
+    int listen_fd;
+    int epoll_fd;
+    Session **sessions;
+    int count;
+    int capacity;
+    uint64_t next_seed;
+    GameConfig config;
+} Server;
+
+//Static layer in cell form: the renderer's layer with box glyphs for the ncurses line characters
+bool ansi_screen_init(AnsiScreen *screen, Renderer *renderer)
+{
+    if (!ansi_screen_alloc(screen, renderer->rows + 2, renderer->cols > 60 ? renderer->cols : 60)) // dwa wiersze tekstu pod plansza
+    {
+        return false;
+    }
+    int rows = renderer->rows, cols = renderer->cols;
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < cols; x++)
+        {
+            chtype cell = renderer->static_cells[y * cols + x];
+            int glyph = (int)(cell & A_CHARTEXT);
+            if (y == 0 || y == rows - 1)
+            {
+                glyph = x == 0 ? (y == 0 ? GlyphUlCorner : GlyphLlCorner) : x == cols - 1 ? (y == 0 ? GlyphUrCorner : GlyphLrCorner) : GlyphHLine;
+            }
+            else if (x == 0 || x == cols - 1)
+            {
+                glyph = GlyphVLine;
+            }
+            screen->base[y * screen->cols + x] = ansi_cell(PAIR_NUMBER(cell), glyph);
+        }
+    }
+    return true;
+}
+
+//Put the moving elements and the text over the static layer
+void ansi_compose(AnsiScreen *screen, Session *session)
+{
+    Simulation *sim = &session->sim;
+    int cols = screen->cols;
+    memcpy(screen->cells, screen->base, sizeof(uint16_t) * screen->rows * cols);
+
+    CarStore *cars = &sim->cars;
+    for (int i = 0; i < cars->count; i++)
+    {
+        const char *car = "o-o";
+        for (int k = 0; k < 3; k++)
+        {
+            int x = cars->x[i] + k;
+            if (x >= 0 && x < sim->config.playing_area_width)
+            {
+                screen->cells[cars->y[i] * cols + x] = ansi_cell(session->renderer.car_pair[i], car[k]);
+            }
+        }
+    }
+    if (sim->state != SimLost) // po przegranej zaby juz nie ma
+    {
+        screen->cells[sim->frog.y * cols + sim->frog.x] = ansi_cell(1, 'O');
+        screen->cells[(sim->frog.y + 1) * cols + sim->frog.x] = ansi_cell(1, 'O');
+    }
+
+    char text[96];
+    int seconds = (int)((long)(sim->game_ticks - session->start_tick) * FrameDelay / 1000000);
+    snprintf(text, sizeof(text), "Time: %d seconds   arrows: jump  e: push  o: quit", seconds);
+    ansi_text(screen, screen->rows - 2, 0, 7, text);
+    if (sim->state != SimRunning)
+    {
+        const char *message = sim->state == SimWon ? "You Won!" : "You Lose!";
+        ansi_text(screen, sim->config.playing_area_height / 2, (sim->config.playing_area_width - (int)strlen(message)) / 2, 7, message);
+        ansi_text(screen, screen->rows - 1, 0, 8, "press any key for the next level");
+    }
+}
+
+void session_watch(Server *server, Session *session, bool writing)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN | (writing ? (uint32_t)EPOLLOUT : 0u);
+    event.data.ptr = session;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, session->fd, &event);
+    session->writing = writing;
+}
+
+void session_close(Server *server, Session *session)
+{
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, session->fd, nullptr);
+    close(session->fd);
+
+    Session *last = server->sessions[--server->count]; // ostatnia sesja zajmuje zwolnione miejsce
+    server->sessions[session->index] = last;
+    last->index = session->index;
+
+    ansi_screen_free(&session->screen);
+    renderer_free(&session->renderer);
+    simulation_free(&session->sim);
+    free(session);
+}
+
+//Send what the socket takes now, the rest waits for EPOLLOUT; false if the client is gone
+bool session_send(Server *server, Session *session)
+{
+    while (session->out_sent < session->screen.out_used)
+    {
+        ssize_t sent = send(session->fd, session->screen.out + session->out_sent, session->screen.out_used - session->out_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (!session->writing)
+                {
+                    session_watch(server, session, true);
+                }
+                return true;
+            }
+            return errno == EINTR;
+        }
+        session->out_sent += (size_t)sent;
+    }
+    session->screen.out_used = session->out_sent = 0;
+    if (session->writing)
+    {
+        session_watch(server, session, false);
+    }
+    return true;
+}
+
+//Start the next level of a session: new seed, new static layer
+bool session_new_game(Server *server, Session *session)
+{
+    if (session->screen.base != nullptr)
+    {
+        free(session->screen.base); // bufor wyjscia zostaje
+        renderer_free(&session->renderer);
+    }
+    simulation_reset(&session->sim, server->next_seed++);
+    session->start_tick = 0;
+    session->queue.count = 0;
+    if (renderer_init(&session->renderer, &session->sim) != 0 || !ansi_screen_init(&session->screen, &session->renderer))
+    {
+        session->screen.base = nullptr;
+        return false;
+    }
+    ansi_put(&session->screen, "\x1b[0m\x1b[2J", 8); // czysty ekran, kolor nieznany
+    return true;
+}
+
+void session_open(Server *server, int fd)
+{
+    Session *session = (Session *)calloc(1, sizeof(Session));
+    Session **sessions = server->sessions;
+    if (session != nullptr && server->count == server->capacity)
+    {
+        int capacity = server->capacity ? server->capacity * 2 : 64;
+        sessions = (Session **)realloc(server->sessions, sizeof(Session *) * capacity);
+        if (sessions != nullptr)
+        {
+            server->sessions = sessions;
+            server->capacity = capacity;
+        }
+    }
+    if (session == nullptr || sessions == nullptr || simulation_init(&session->sim, server->config, server->next_seed) != 0)
+    {
+        free(session);
+        close(fd);
+        return;
+    }
+    session->fd = fd;
+    session->index = server->count;
+    session->input = InputNormal;
+    server->sessions[server->count++] = session;
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = session;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+    //Telnet: the server echoes (nothing) and every key comes at once; then hide the cursor
+    const unsigned char hello[] = {255, 251, 1, 255, 251, 3, 27, '[', '?', '2', '5', 'l'};
+    ansi_put(&session->screen, (const char *)hello, sizeof(hello));
+    if (!session_new_game(server, session) || !session_send(server, session))
+    {
+        session_close(server, session);
+    }
+}
+
+//Turn telnet bytes into keys for the session; false when the client quits
+bool session_input(Server *server, Session *session, const unsigned char *data, ssize_t size)
+{
+    for (ssize_t i = 0; i < size; i++)
+    {
+        unsigned char c = data[i];
+        int key = ERR;
+        switch (session->input)
+        {
+            case InputNormal:
+                if (c == 255)
+                {
+                    session->input = InputIac;
+                }
+                else if (c == 27)
+                {
+                    session->input = InputEscape;
+                }
+                else if (c >= ' ' && c < 127)
+                {
+                    key = c;
+                }
+                break;
+            case InputIac:
+                session->input = c >= 251 && c <= 254 ? InputIacOption : c == 250 ? InputSub : InputNormal;
+                break;
+            case InputIacOption:
+                session->input = InputNormal;
+                break;
+            case InputSub:
+                session->input = c == 255 ? InputSubIac : InputSub;
+                break;
+            case InputSubIac:
+                session->input = c == 240 ? InputNormal : InputSub;
+                break;
+            case InputEscape:
+                session->input = c == '[' || c == 'O' ? InputCsi : InputNormal;
+                break;
+            case InputCsi:
+                if (c >= 'A' && c <= 'D')
+                {
+                    int arrows[] = {KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT};
+                    key = arrows[c - 'A'];
+                }
+                if (c >= '@') // koniec sekwencji
+                {
+                    session->input = InputNormal;
+                }
+                break;
+        }
+
+        if (key == 'o')
+        {
+            return false;
+        }
+        if (key != ERR && session->sim.state != SimRunning && !session_new_game(server, session))
+        {
+            return false;
+        }
+        else if (key != ERR)
+        {
+            input_push(&session->queue, key, 0);
+            input_apply(&session->queue, &session->sim, nullptr);
+        }
+    }
+    return true;
+}
+
+//Listen on a Unix socket path (anything with a '/') or on a TCP port of localhost
+int server_listen(const char *address)
+{
+    int fd;
+    if (strchr(address, '/') != nullptr)
+    {
+        struct sockaddr_un local;
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        strncpy(local.sun_path, address, sizeof(local.sun_path) - 1);
+        unlink(address);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0 || bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0)
+        {
+            perror("Cannot bind server socket");
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_port = htons((uint16_t)atoi(address));
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int yes = 1;
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd >= 0)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        }
+        if (fd < 0 || bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0)
+        {
+            perror("Cannot bind server socket");
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return -1;
+        }
+    }
+    if (listen(fd, SOMAXCONN) != 0)
+    {
+        perror("Cannot listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//All sessions in one thread: epoll for sockets, one shared tick for every game
+int run_server(GameConfig config, Options *options)
+{
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.config = config;
+    server.next_seed = options->seed;
+    server.listen_fd = server_listen(options->serve);
+    server.epoll_fd = epoll_create1(0);
+    if (server.listen_fd < 0 || server.epoll_fd < 0)
+    {
+        return 1;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr; // nullptr - gniazdo nasluchujace
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &event);
+    fprintf(stderr, "serving on %s\n", options->serve);
+
+    struct epoll_event events[ServerEvents];
+    unsigned char buffer[4096];
+    GameClock game_clock;
+    clock_init(&game_clock, 1.0);
+    long long report = game_clock.real_last + ServerReport;
+    long long tick_work = 0, tick_max = 0, ticks = 0;
+    while (true)
+    {
+        long long now = monotonic_usec();
+        long long next_tick = clock_next_tick(&game_clock);
+        int timeout = next_tick > now ? (int)((next_tick - now + 999) / 1000) : 0;
+        int ready = epoll_wait(server.epoll_fd, events, ServerEvents, timeout);
+        for (int k = 0; k < ready; k++)
+        {
+            Session *session = (Session *)events[k].data.ptr;
+            if (session == nullptr) // nowi klienci
+            {
+                int fd;
+                while ((fd = accept4(server.listen_fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0)
+                {
+                    session_open(&server, fd);
+                }
+                continue;
+            }
+
+            bool alive = !(events[k].events & (EPOLLERR | EPOLLHUP));
+            if (alive && (events[k].events & EPOLLIN))
+            {
+                ssize_t size = recv(session->fd, buffer, sizeof(buffer), 0);
+                alive = (size > 0 && session_input(&server, session, buffer, size)) || (size < 0 && errno == EAGAIN);
+            }
+            if (alive && (events[k].events & EPOLLOUT))
+            {
+                alive = session_send(&server, session);
+            }
+            if (!alive)
+            {
+                session_close(&server, session);
+            }
+        }
+
+        int due = clock_advance(&game_clock);
+        if (due == 0)
+        {
+            continue;
+        }
+        now = game_clock.real_last;
+
+        //Ticks of every game the clock owes, one frame after them only for clients that keep up
+        long long start = monotonic_nsec();
+        for (int i = 0; i < server.count; i++)
+        {
+            Session *session = server.sessions[i];
+            for (int t = 0; t < due; t++)
+            {
+                simulation_tick(&session->sim);
+                input_apply(&session->queue, &session->sim, nullptr);
+            }
+            if (session->screen.out_used - session->out_sent < ServerBacklog)
+            {
+                ansi_compose(&session->screen, session);
+                ansi_flush_frame(&session->screen);
+            }
+            if (!session_send(&server, session))
+            {
+                session_close(&server, session);
+                i--; // na to miejsce weszla ostatnia sesja
+            }
+        }
+        long long work = monotonic_nsec() - start;
+        tick_work += work;
+        tick_max = work > tick_max ? work : tick_max;
+        ticks++;
+
+        if (now >= report)
+        {
+            fprintf(stderr, "sessions: %d, tick work: %.1f us mean, %.1f us max (%.1f%% of a %d ms tick)\n", server.count,
+                    tick_work / 1000.0 / ticks, tick_max / 1000.0, tick_work / 10.0 / ticks / FrameDelay, FrameDelay / 1000);
+            tick_work = tick_max = ticks = 0;
+            report = now + ServerReport;
+        }
+    }
+    return 0;
+}
+
+//Parse command line options
+int parse_options(int argc, char *argv[], Options *options)
+{
+    options->headless = false;
+    options->ticks = 0; // 0 - domyslny limit dla danego trybu
+    options->config_file = "config.txt";
+    options->seed = (uint64_t)time(NULL); // bez --seed kazda gra jest inna
+    options->montecarlo = 0;
+    options->threads = (int)thread::hardware_concurrency();
+    options->policy = PolicyCautious;
+    options->record_file = nullptr;
+    options->events_file = nullptr;
+    options->publish_file = nullptr;
+    options->spectate_file = nullptr;
+    options->replay_file = nullptr;
+    options->bot = false;
+    options->generate = 0;
+    options->pack_file = nullptr;
+    options->level = -1;
+    options->stats_file = nullptr;
+    options->overlay = false;
+    options->bench = false;
+    options->serve = nullptr;
+    options->ansi = false;
+    options->envbench = 0;
+    options->speed = 0;
+    options->endless = false;
+    options->threaded = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+        {
+            options->headless = true;
+        }
+        else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+        {
+            options->ticks = strtol(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            options->seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+        {
+            options->config_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--publish") == 0 && i + 1 < argc)
+        {
+            options->publish_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--spectate") == 0 && i + 1 < argc)
+        {
+            options->spectate_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc)
+        {
+            options->events_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            options->record_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            options->replay_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--bot") == 0)
+        {
+            options->bot = true;
+        }
+        else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc)
+        {
+            options->generate = strtol(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+        {
+            options->pack_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc)
+        {
+            options->level = strtol(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+        {
+            options->stats_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--overlay") == 0)
+        {
+            options->overlay = true;
+        }
+        else if (strcmp(argv[i], "--bench") == 0)
+        {
+            options->bench = true;
+        }
+        else if (strcmp(argv[i], "--ansi") == 0)
+        {
+            options->ansi = true;
+        }
+        else if (strcmp(argv[i], "--endless") == 0)
+        {
+            options->endless = true;
+        }
+        else if (strcmp(argv[i], "--threaded") == 0)
+        {
+            options->threaded = true;
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            options->serve = argv[++i];
+        }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+        {
+            options->speed = strtod(argv[++i], nullptr);
+        }
+        else if (strcmp(argv[i], "--envbench") == 0 && i + 1 < argc)
+        {
+            options->envbench = strtol(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--montecarlo") == 0 && i + 1 < argc)
+        {
+            options->montecarlo = strtol(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            options->threads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc)
+        {
+            i++;
+            options->policy = strcmp(argv[i], "random") == 0 ? PolicyRandom : strcmp(argv[i], "lookahead") == 0 ? PolicyLookahead : PolicyCautious;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            fprintf(stderr, "Usage: %s [--config file] [--seed N] [--headless] [--ticks N]\n"
+                            "       [--record file] [--replay file] [--bot] [--speed X] [--endless] [--events file]\n"
+                            "       [--generate N --pack file] [--pack file --level K]\n"
+                            "       [--stats file] [--overlay] [--ansi] [--bench] [--serve port|path]\n"
+                            "       [--publish file] [--spectate file] [--threaded]\n"
+                            "       [--montecarlo N] [--threads T] [--policy random|cautious|lookahead] [--envbench N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (options->threads < 1)
+    {
+        options->threads = 1;
+    }
+    if (options->montecarlo > (long)UINT32_MAX || options->generate > (long)UINT32_MAX) // kolejka pracy trzyma konce zakresu w 32 bitach
+    {
+        fprintf(stderr, "--montecarlo and --generate take at most %u games\n", UINT32_MAX);
+        return 1;
+    }
+    if ((options->generate > 0 || options->level >= 0) && options->pack_file == nullptr)
+    {
+        fprintf(stderr, "--generate and --level need --pack file\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    GameConfig config; //przechowuje konfigurajce gry
+    Options options; //opcje z linii polecen
+
+    if (parse_options(argc, argv, &options) != 0)
+    {
+        return 1;
+    }
+    if (options.bench) // wlasne plansze, bez pliku konfiguracji
+    {
+        return run_bench();
+    }
+    if (options.spectate_file != nullptr) // gra i konfiguracja przychodza od wydawcy
+    {
+        return run_spectator(options.spectate_file);
+    }
+
+    //Replay brings its own seed and config
+    ReplayReader reader;
+    const unsigned char *replay = nullptr;
+    size_t replay_size = 0;
+    if (options.replay_file != nullptr)
+    {
+        replay = replay_open(options.replay_file, &replay_size, &reader, &config, &options.seed);
+        if (replay == nullptr || validate_config(&config) != 0)
+        {
+            return 1;
+        }
+    }
+    //A level from a pack is a config and a seed
+    else if (options.level >= 0 && options.generate == 0)
+    {
+        if (load_level(options.pack_file, options.level, &config, &options.seed) != 0 || validate_config(&config) != 0)
+        {
+            return 1;
+        }
+    }
+    //Zaladowanie kofuguracji gry
+    else if (load_config(options.config_file, &config) != 0 || validate_config(&config) != 0)
+    {
+        return 1;
+    }
+
+    //Dense lanes move cars together, the solver predicts every hostile car on its own
+    int car_count = config.number_of_hostile_cars + config.number_of_friendly_cars + config.number_of_stopping_cars;
+    if (car_count > config.number_of_roads && ((options.bot && replay == nullptr) || options.generate > 0 || options.level >= 0 ||
+                                               options.endless || config.endless))
+    {
+        fprintf(stderr, "More cars than roads does not work with --bot, --generate, --level or --endless\n");
+        return 1;
+    }
+
+    //Endless mode streams new rows from the game rng, the fixed-board tools cannot follow it
+    if (options.endless && replay == nullptr)
+    {
+        config.endless = 1;
+    }
+    if (config.endless && ((options.bot && replay == nullptr) || options.generate > 0 || options.level >= 0 || options.serve != nullptr ||
+                           options.envbench > 0 || options.policy == PolicyLookahead))
+    {
+        fprintf(stderr, "Endless mode does not work with --bot, --generate, --level, --serve, --envbench or --policy lookahead\n");
+        return 1;
+    }
+
+    if (options.envbench > 0) // srodowiska dla uczenia agentow, krok wszystkich naraz
+    {
+        return run_envbench(config, &options);
+    }
+    if (options.montecarlo > 0) // wiele niezaleznych gier na wszystkich rdzeniach
+    {
+        return run_montecarlo(config, &options);
+    }
+    if (options.generate > 0) // paczka sprawdzonych poziomow
+    {
+        return run_generate(config, &options);
+    }
+    if (options.serve != nullptr) // wiele gier przez gniazda, bez ncurses
+    {
+        return run_server(config, &options);
+    }
+
+    //Caly stan gry w jednej strukturze
+    Simulation sim;
+    if (simulation_init(&sim, config, options.seed) != 0)
+    {
+        return 1;
+    }
+
+    Recording recording = {nullptr, 0, 0, 0};
+    if (options.record_file != nullptr)
+    {
+        sim.recording = &recording;
+    }
+
+    //Gameplay events go to a file from a background thread
+    EventLog events;
+    if (options.events_file != nullptr)
+    {
+        if (event_log_open(&events, options.events_file, &sim) != 0)
+        {
+            simulation_free(&sim);
+            return 1;
+        }
+        sim.events = &events;
+    }
+
+    //The bot plays its plan the same way a recording is replayed
+    Recording plan = {nullptr, 0, 0, 0};
+    if (options.bot && replay == nullptr && !bot_plan(&sim, &plan, &reader))
+    {
+        if (sim.events != nullptr)
+        {
+            event_log_close(&events);
+        }
+        simulation_free(&sim);
+        return 1;
+    }
+    bool scripted = replay != nullptr || options.bot;
+
+    int result = 0;
+    if (options.headless) // bez terminala, tylko symulacja
+    {
+        if (scripted)
+        {
+            result = run_replay_headless(&sim, &reader);
+        }
+        else
+        {
+            result = run_headless(&sim, options.ticks > 0 ? options.ticks : HeadlessTicks);
+        }
+    }
+    else
+    {
+        WINDOW *board_win = initialize_ncurses(config);
+        Renderer renderer;
+        if (board_win == nullptr || renderer_init(&renderer, &sim) != 0) // jesli sie nie udalo to konczymy
+        {
+            endwin();
+            simulation_free(&sim);
+            return 1;
+        }
+
+        //Frame timing only when asked for
+        if (options.stats_file != nullptr || options.overlay)
+        {
+            renderer.stats = (FrameStats *)calloc(1, sizeof(FrameStats));
+            if (renderer.stats != nullptr)
+            {
+                renderer.stats->overlay = options.overlay;
+            }
+        }
+
+        //ANSI backend: ncurses still reads the keyboard, frames go straight to stdout
+        AnsiScreen ansi = {};
+        if (options.ansi && ansi_screen_alloc(&ansi, LINES, COLS))
+        {
+            ansi.fd = STDOUT_FILENO;
+            renderer.ansi = &ansi;
+        }
+
+        //Spectators map the frames this renderer publishes
+        SpectatorRing spectators;
+        if (options.publish_file != nullptr && spectator_create(&spectators, options.publish_file, &sim) == 0)
+        {
+            renderer.spectators = &spectators;
+        }
+
+        //Draw initial game state
+        draw_initial_state(board_win, &renderer, &sim);
+
+        //Start gameplay loop
+        double speed = options.speed > 0 ? options.speed : replay != nullptr ? ReplaySpeed : 1.0;
+        if (!options.threaded || !gameplay_threaded(board_win, &renderer, &sim, scripted ? &reader : nullptr, speed))
+        {
+            gameplay(board_win, &renderer, &sim, scripted ? &reader : nullptr, speed);
+        }
+
+        delwin(board_win); // usuwa okno board_win z pamieci
+        endwin(); // konczy dzialanie ncurses
+        if (renderer.stats != nullptr && options.stats_file != nullptr && stats_save(renderer.stats, options.stats_file) != 0)
+        {
+            result = 1;
+        }
+        free(renderer.stats);
+        ansi_screen_free(&ansi);
+        if (renderer.spectators != nullptr)
+        {
+            spectator_close(&spectators);
+        }
+        renderer_free(&renderer);
+    }
+
+    if (options.record_file != nullptr && recording_save(&recording, options.record_file, &sim) != 0)
+    {
+        result = 1;
+    }
+    if (sim.events != nullptr && event_log_close(&events) != 0)
+    {
+        result = 1;
+    }
+    recording_free(&recording);
+    recording_free(&plan);
+    if (replay != nullptr)
+    {
+        munmap((void *)replay, replay_size);
+    }
+    simulation_free(&sim);
+
+    return result;
+}